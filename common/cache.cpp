@@ -1,5 +1,7 @@
 #include <assert.h>
 
+#include "settings.h"
+
 #include "stack_ptr.hpp"
 #include "cache.hpp"
 
@@ -7,19 +9,94 @@ namespace aspell {
 
 static StackPtr<Mutex> global_cache_lock(new Mutex);
 static GlobalCacheBase * first_cache = 0;
+// set under global_cache_lock, but read under each cache's lock
+static bool keep_cache_data = false;
 
+#ifndef ACOMMON_LOCK_FREE_CACHE
 void Cacheable::copy() const
 {
   //CERR << "COPY\n";
   LOCK(&cache->lock);
   copy_no_lock();
 }
+#endif
+
+// Lock free lookups may still be looking at data that was just
+// removed from the list, so rather than deleting it, it is retired
+// and deleted by reclaim once they are done.  Must be called with
+// the lock held.
+void GlobalCacheBase::retire(Cacheable * d)
+{
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  d->retired_next = retired_cur;
+  retired_cur = d;
+  reclaim();
+#else
+  delete d;
+#endif
+}
+
+#ifdef ACOMMON_LOCK_FREE_CACHE
+static void delete_retired(Cacheable * p)
+{
+  while (p) {
+    Cacheable * n = p->retired_next;
+    delete p;
+    p = n;
+  }
+}
+#endif
+
+// Deletes the retired data that no lock free lookup can still be
+// looking at.  It never waits, data that can't be deleted yet is
+// left for a later call.  Must be called with the lock held.
+//
+// A lookup counts itself in the epoch it started in, and any lookup
+// that starts after the epoch is advanced can't find data retired
+// before it.  Thus data retired before the epoch was advanced is safe
+// to delete once the count of the previous epoch is 0.  The epoch is
+// only advanced again once that data is deleted, so every lookup of
+// the previous epoch is one that started before it was advanced.
+void GlobalCacheBase::reclaim()
+{
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  if (retired_prev) {
+    if (__atomic_load_n(&readers[(epoch - 1) & 1], __ATOMIC_SEQ_CST) != 0)
+      return;
+    delete_retired(retired_prev);
+    retired_prev = 0;
+  }
+  if (!retired_cur) return;
+  retired_prev = retired_cur;
+  retired_cur = 0;
+  __atomic_store_n(&epoch, epoch + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&readers[(epoch - 1) & 1], __ATOMIC_SEQ_CST) != 0)
+    return;
+  delete_retired(retired_prev);
+  retired_prev = 0;
+#endif
+}
+
+// The list is changed only while holding the lock, however, lock
+// free lookups may be walking it at the same time, thus "first" and
+// "next" are changed atomically.  A lookup that is stopped on a node
+// when it is removed ends its walk early, as "next" is cleared, and
+// may thus miss data that is in the cache.  That is harmless since
+// get_cache_data then falls back to a find with the lock held.
 
 void GlobalCacheBase::del(Cacheable * n)
 {
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  __atomic_store_n(n->prev, n->next, __ATOMIC_SEQ_CST);
+#else
   *n->prev = n->next;
+#endif
   if (n->next) n->next->prev = n->prev;
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  __atomic_store_n(&n->next, (Cacheable *)0, __ATOMIC_RELAXED);
+#else
   n->next = 0;
+#endif
   n->prev = 0;
 }
 
@@ -28,21 +105,50 @@ void GlobalCacheBase::add(Cacheable * n)
   assert(n->refcount > 0);
   n->next = first;
   n->prev = &first;
+  n->cache = this;
   if (first) first->prev = &n->next;
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  __atomic_store_n(&first, n, __ATOMIC_RELEASE);
+  // a good time to delete any retired data left from before
+  reclaim();
+#else
   first = n;
-  n->cache = this;
+#endif
 }
 
 void GlobalCacheBase::release(Cacheable * d) 
 {
   //CERR << "RELEASE\n";
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  // unless this is the last reference there is nothing else to do
+  int r = __atomic_load_n(&d->refcount, __ATOMIC_RELAXED);
+  while (r > 1)
+    if (__atomic_compare_exchange_n(&d->refcount, &r, r - 1, true,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      return;
+  // The refcount can only go from 1 to 0 while holding the lock and
+  // lock free lookups won't increment it once it is 0.
+  LOCK(&lock);
+  r = __atomic_sub_fetch(&d->refcount, 1, __ATOMIC_ACQ_REL);
+  assert(r >= 0);
+  if (r != 0) return;
+#else
   LOCK(&lock);
   d->refcount--;
   assert(d->refcount >= 0);
   if (d->refcount != 0) return;
+#endif
+  // when keeping the data around it stays in the cache, unused,
+  // until the cache is reset
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  bool keep = __atomic_load_n(&keep_cache_data, __ATOMIC_RELAXED);
+#else
+  bool keep = keep_cache_data;
+#endif
+  if (keep && d->attached()) return;
   //CERR << "DEL\n";
   if (d->attached()) del(d);
-  delete d;
+  retire(d);
 }
 
 void GlobalCacheBase::detach(Cacheable * d)
@@ -55,10 +161,18 @@ void GlobalCacheBase::detach_all()
 {
   LOCK(&lock);
   Cacheable * p = first;
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  __atomic_store_n(&first, (Cacheable *)0, __ATOMIC_SEQ_CST);
+#else
+  first = 0;
+#endif
+  for (Cacheable * i = p; i; i = i->next)
+    i->prev = 0;
+  // only unused data that was kept around has a refcount of 0
   while (p) {
-    *p->prev = 0;
-    p->prev = 0;
-    p = p->next;
+    Cacheable * n = p->next;
+    if (p->refcount == 0) retire(p);
+    p = n;
   }
 }
 
@@ -70,6 +184,11 @@ void release_cache_data(GlobalCacheBase * cache, const Cacheable * d)
 GlobalCacheBase::GlobalCacheBase(const char * n)
   : name (n)
 {
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  readers[0] = readers[1] = 0;
+  epoch = 0;
+  retired_cur = retired_prev = 0;
+#endif
   LOCK(global_cache_lock);
   next = first_cache;
   prev = &first_cache;
@@ -79,7 +198,14 @@ GlobalCacheBase::GlobalCacheBase(const char * n)
 
 GlobalCacheBase::~GlobalCacheBase()
 {
-  detach_all();
+  // Don't use detach_all as any kept or retired data can't safely be
+  // deleted this late, the caches it may refer to may already be gone.
+  {
+    LOCK(&lock);
+    for (Cacheable * p = first; p; p = p->next)
+      p->prev = 0;
+    first = 0;
+  }
   LOCK(global_cache_lock);
   *prev = next;
   if (next) next->prev = prev;
@@ -91,17 +217,35 @@ bool reset_cache(const char * which)
   bool any = false;
   for (GlobalCacheBase * i = first_cache; i; i = i->next)
   {
-    if (which && strcmp(i->name, which) == 0) {i->detach_all(); any = true;}
+    if (!which || strcmp(i->name, which) == 0) {i->detach_all(); any = true;}
   }
   return any;
 }
 
+bool keep_cache(bool keep)
+{
+  LOCK(global_cache_lock);
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  return __atomic_exchange_n(&keep_cache_data, keep, __ATOMIC_RELAXED);
+#else
+  bool prev = keep_cache_data;
+  keep_cache_data = keep;
+  return prev;
+#endif
+}
+
 extern "C"
 int aspell_reset_cache(const char * which)
 {
   return reset_cache(which);
 }
 
+extern "C"
+int aspell_keep_cache(int keep)
+{
+  return keep_cache(keep);
+}
+
 #if 0
 
 struct CacheableImpl : public Cacheable
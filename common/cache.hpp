@@ -4,6 +4,19 @@
 #include "lock.hpp"
 #include "posib_err.hpp"
 
+// When atomic operations are available finding data that is already
+// in a cache and is in use does not need the cache's lock.  Instead
+// the list of data is only changed while holding the lock, and data
+// removed from it is retired rather than deleted.  Retired data is
+// deleted later, once no lock free lookup that may have seen it is
+// still in progress.  A lock free lookup may miss data that is being
+// added or removed at the same time, so when it finds nothing the
+// lookup is repeated with the lock held.
+
+#ifdef __ATOMIC_ACQUIRE
+#  define ACOMMON_LOCK_FREE_CACHE
+#endif
+
 namespace aspell {
 
 class Cacheable;
@@ -12,6 +25,16 @@ class GlobalCacheBase
 {
 public:
   mutable Mutex lock;
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  // Lock free lookups count themselves in readers[epoch & 1].  Data
+  // retired during the current epoch is in retired_cur.  When the
+  // epoch is advanced it is moved to retired_prev, which is deleted
+  // once readers[(epoch - 1) & 1] is 0.
+  mutable int readers[2];
+  unsigned epoch;
+  Cacheable * retired_cur;
+  Cacheable * retired_prev;
+#endif
 public: // but don't use
   const char * name;
   GlobalCacheBase * next;
@@ -20,6 +43,8 @@ protected:
   Cacheable * first;
   void del(Cacheable * d);
   void add(Cacheable * n);
+  void retire(Cacheable * d);
+  void reclaim();
   GlobalCacheBase(const char * n);
   ~GlobalCacheBase();
 public:
@@ -43,6 +68,11 @@ public:
       cur = static_cast<D *>(cur->next);
     return cur;
   }
+  // "find_copy" is like "find" but it increments the refcount of the
+  // data found.  It does not acquire a lock but may fail to find data
+  // that is not in use, in which case "find" should be tried with
+  // the lock held.
+  Data * find_copy(const Key & key);
   void add(Data * n) {GlobalCacheBase::add(n);}
   // "release" and "detach" _will_ acquire a lock
   void release(Data * d) {GlobalCacheBase::release(d);}
@@ -57,11 +87,13 @@ PosibErr<Data *> get_cache_data(GlobalCache<Data> * cache,
                                 const typename Data::CacheConfig * config, 
                                 const typename Data::CacheKey & key)
 {
+  Data * n = cache->find_copy(key);
+  if (n) return n;
   LOCK(&cache->lock);
-  Data * n = cache->find(key);
+  n = cache->find(key);
   //CERR << "Getting " << key << " for " << cache->name << "\n";
   if (n) {
-    n->refcount++;
+    n->copy_no_lock();
     return n;
   }
   PosibErr<Data *> res = Data::get_new(key, config);
@@ -81,17 +113,19 @@ PosibErr<Data *> get_cache_data(GlobalCache<Data> * cache,
                                 const typename Data::CacheConfig2 * config2,
                                 const typename Data::CacheKey & key)
 {
+  Data * n = cache->find_copy(key);
+  if (n) return n;
   LOCK(&cache->lock);
-  Data * n = cache->find(key);
+  n = cache->find(key);
   //CERR << "Getting " << key << "\n";
   if (n) {
-    n->refcount++;
+    n->copy_no_lock();
     return n;
   }
   PosibErr<Data *> res = Data::get_new(key, config, config2);
   if (res.has_err()) {
     //CERR << "ERROR\n"; 
-    return res;
+    return PosibErrBase(res);
   }
   n = res.data;
   cache->add(n);
@@ -112,15 +146,65 @@ public: // but don't use
   Cacheable * * prev;
   mutable int refcount;
   GlobalCacheBase * cache;
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  Cacheable * retired_next; // "next" is cleared once removed
+#endif
 public:
   bool attached() {return prev;}
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  void copy_no_lock() const {__atomic_add_fetch(&refcount, 1, __ATOMIC_RELAXED);}
+  void copy() const {copy_no_lock();}
+  // increments the refcount unless it is 0
+  bool try_copy() const {
+    int r = __atomic_load_n(&refcount, __ATOMIC_RELAXED);
+    while (r != 0)
+      if (__atomic_compare_exchange_n(&refcount, &r, r + 1, true,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return true;
+    return false;
+  }
+#else
   void copy_no_lock() const {refcount++;}
   void copy() const; // Acquires cache->lock
-  void release() const {release_cache_data(cache,this);} // Acquires cache->lock
-  Cacheable(GlobalCacheBase * c = 0) : next(0), prev(0), refcount(1), cache(c) {}
+#endif
+  // Acquires cache->lock, unless atomic operations are available
+  // and this isn't the last reference
+  void release() const {release_cache_data(cache,this);}
+  Cacheable(GlobalCacheBase * c = 0) : next(0), prev(0), refcount(1), cache(c) {
+#ifdef ACOMMON_LOCK_FREE_CACHE
+    retired_next = 0;
+#endif
+  }
   virtual ~Cacheable() {}
 };
 
+template <class D>
+D * GlobalCache<D>::find_copy(const Key & key)
+{
+#ifdef ACOMMON_LOCK_FREE_CACHE
+  // Count this lookup in the current epoch.  If the epoch changed in
+  // the meantime the count may have been missed, so try again.
+  unsigned e;
+  for (;;) {
+    e = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&readers[e & 1], 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&epoch, __ATOMIC_SEQ_CST) == e) break;
+    __atomic_sub_fetch(&readers[e & 1], 1, __ATOMIC_RELEASE);
+  }
+  D * cur = static_cast<D *>(__atomic_load_n(&first, __ATOMIC_SEQ_CST));
+  while (cur && !cur->cache_key_eq(key))
+    cur = static_cast<D *>(__atomic_load_n(&cur->next, __ATOMIC_SEQ_CST));
+  if (cur && !cur->try_copy()) cur = 0;
+  __atomic_sub_fetch(&readers[e & 1], 1, __ATOMIC_RELEASE);
+  return cur;
+#else
+  LOCK(&lock);
+  D * cur = find(key);
+  if (cur) cur->copy_no_lock();
+  return cur;
+#endif
+}
+
 template <class Data>
 class CachePtr
 {
@@ -158,6 +242,12 @@ PosibErr<void> setup(CachePtr<Data> & res,
 
 bool reset_cache(const char * = 0);
 
+// When true, data whose last user is released is kept in the cache
+// rather than deleted so later requests for it don't have to build
+// it again.  Kept data is deleted when the cache is reset.  Returns
+// the previous setting.
+bool keep_cache(bool);
+
 }
 
 #endif
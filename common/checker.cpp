@@ -46,9 +46,9 @@ namespace aspell {
     }
   }
 
-  void Checker::init(Speller * speller)
+  void Checker::init(Speller * speller, CheckContext * ctx)
   {
-    conv_ = speller->to_internal_;
+    conv_ = ctx ? ctx->to_internal_.get() : speller->to_internal_.get();
   }
 
   const FilterChar SegmentIterator::empty_str[1] = {FilterChar(0,0)};
@@ -57,6 +57,7 @@ namespace aspell {
  
   void Checker::reset()
   {
+    if (filter_) filter_->reset();
     free_segments();
     Segment * seg = new Segment;
     first = seg;
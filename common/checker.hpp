@@ -19,6 +19,7 @@ namespace aspell {
 
   class Config;
   class Speller;
+  class CheckContext;
   class FullConvert;
 
   struct SegmentData : public FilterCharVector {
@@ -103,8 +104,9 @@ namespace aspell {
     // if f is null than free all segments up to l
     // if f is non-null than l must also be non-null
     
-    // this needs to be called by the derived class in the constructor
-    void init(Speller * speller);
+    // this needs to be called by the derived class in the constructor,
+    // if "ctx" is given its converter is used instead of the speller's
+    void init(Speller * speller, CheckContext * ctx = 0);
 
     void need_more(Segment * seg) // seg = last segment on list
       {if (more_data_callback_) more_data_callback_(more_data_callback_data_, seg->which);}
@@ -170,6 +172,14 @@ namespace aspell {
     void set_filter(Filter * f) // will take ownership of filter
       {filter_.reset(f);}
 
+    bool save_filter_state(String & buf) const
+      {return !filter_ || filter_->save_state(buf);}
+    void restore_filter_state(const char * state)
+      {if (filter_) filter_->restore_state(state);}
+    // save and restore the state of the filter, so that a string
+    // can be processed again starting from the same state, see
+    // IndividualFilter::save_state
+
     void set_more_data_callback(void (*c)(void *, void *), void * d) 
       {more_data_callback_ = c; more_data_callback_data_ = d;}
     // sets the callback that is called when more data is needed.  The
@@ -251,6 +261,11 @@ namespace aspell {
   
   PosibErr<Checker *> new_checker(Speller *);
 
+  // Creates a checker for a frozen speller which has its own check
+  // context, so that checkers for the same speller may be used by
+  // different threads at the same time.
+  PosibErr<Checker *> new_thread_checker(Speller *);
+
 }
 
 #endif /* ASPELL_DOCUMENT_CHECKER__HPP */
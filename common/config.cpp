@@ -1419,6 +1419,14 @@ namespace aspell {
        N_("create dictionary aliases")}
     , {"dict-dir", KeyInfoString, DICT_DIR,
        N_("location of the main word list")}
+    , {"dict-huge-pages", KeyInfoBool, "false",
+       N_("ask for huge pages when mapping dictionaries")}
+    , {"dict-lock", KeyInfoBool, "false",
+       N_("lock mapped dictionaries in memory")}
+    , {"dict-prefault", KeyInfoBool, "false",
+       N_("read all of a dictionary in when it is mapped")}
+    , {"dict-warm", KeyInfoBool, "false",
+       N_("read the dictionary indexes in the background after loading")}
     , {"encoding",   KeyInfoString, "!encoding",
        N_("encoding to expect data to be in"), KEYINFO_COMMON}
     //, {"encoding-layers",   KeyInfoString, "!encoding",
@@ -1513,6 +1521,8 @@ namespace aspell {
        N_("use replacement tables, override sug-mode default")}
     , {"sug-split-char", KeyInfoList, "\\ :-",
        N_("characters to insert when a word is split"), KEYINFO_UTF8}
+    , {"sug-threads", KeyInfoInt, "1",
+       N_("threads to use for suggestions, 0 for all cpus")}
     , {"use-other-dicts", KeyInfoBool, "true",
        N_("use personal, replacement & session dictionaries")}
     , {"variety", KeyInfoList, "",
@@ -1542,6 +1552,12 @@ namespace aspell {
        N_("remove invalid affix flags")}
     , {"clean-words", KeyInfoBool, "false",
        N_("attempts to clean words so that they are valid")}
+    , {"create-memory", KeyInfoInt, "512",
+       N_("megabytes of words kept in memory when creating dictionaries")}
+    , {"create-threads", KeyInfoInt, "0",
+       N_("threads used when creating dictionaries, 0 for one per processor")}
+    , {"bloom-filter-bits", KeyInfoInt, "10",
+       N_("bits per word for the filter in front of word lookups, 0 for none")}
     , {"invisible-soundslike", KeyInfoBool, "false",
        N_("compute soundslike on demand rather than storing")} 
     , {"partially-expand",  KeyInfoBool, "false",
@@ -1567,8 +1583,12 @@ namespace aspell {
        N_("keymapping for check mode: \"aspell\" or \"ispell\"")}
     , {"reverse", KeyInfoBool, "false",
        N_("reverse the order of the suggest list")}
+    , {"stream", KeyInfoBool, "false",
+       N_("buffer input and output and number results in pipe mode")}
     , {"suggest", KeyInfoBool, "true",
        N_("suggest possible replacements"), KEYINFO_MAY_CHANGE}
+    , {"threads", KeyInfoInt, "0",
+       N_("threads used by the scan command, 0 for one per processor")}
     , {"time"   , KeyInfoBool, "false",
        N_("time load time and suggest time in pipe mode"), KEYINFO_MAY_CHANGE}
 
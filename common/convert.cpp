@@ -29,6 +29,12 @@
 
 #include "gettext.h"
 
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 //If the max macro was defined, undefine it. We use max as a field name.
 #ifdef max
 #undef max
@@ -679,12 +685,30 @@ namespace aspell {
   {
     typedef FromUniNormEntry E;
     NormTable<E> * data;
-    EncodeNormLookup(NormTable<E> * d) : data(d) {}
+    // true for the ASCII characters which the table maps to
+    // themselves no matter what follows them, those can be copied
+    // without looking them up
+    bool plain_ascii[0x80];
+    EncodeNormLookup(NormTable<E> * d) : data(d) {
+      plain_ascii[0] = false;
+      for (Uni32 c = 1; c != 0x80; ++c) {
+        const E * i = d->data + (c & d->mask);
+        while (i < d->end && i->from != c) i += d->height;
+        plain_ascii[c] = (i < d->end && !i->sub_table 
+                          && i->to[0] == c && i->to[1] == 0);
+      }
+    }
+    bool is_plain(const FilterChar * in) const {
+      return in->chr < 0x80 && plain_ascii[in->chr];
+    }
     // *stop must equal 0
     void encode(const FilterChar * in, const FilterChar * stop, 
                 CharVector & out) const {
       while (in < stop) {
-        if (*in == 0) {
+        if (is_plain(in)) {
+          out.append(static_cast<char>(in->chr));
+          ++in;
+        } else if (*in == 0) {
           out.append('\0');
           ++in;
         } else {
@@ -699,7 +723,10 @@ namespace aspell {
     PosibErr<void> encode_ec(const FilterChar * in, const FilterChar * stop, 
                              CharVector & out, ParmStr orig) const {
       while (in < stop) {
-        if (*in == 0) {
+        if (is_plain(in)) {
+          out.append(static_cast<char>(in->chr));
+          ++in;
+        } else if (*in == 0) {
           out.append('\0');
           ++in;
         } else {
@@ -720,7 +747,10 @@ namespace aspell {
     void encode(const FilterChar * in, const FilterChar * stop,
                 FilterCharVector & out) const {
       while (in < stop) {
-        if (*in == 0) {
+        if (is_plain(in)) {
+          out.append(*in);
+          ++in;
+        } else if (*in == 0) {
           out.append(FilterChar(0));
           ++in;
         } else {
@@ -785,6 +815,46 @@ namespace aspell {
     return FilterChar(err_char, w);
   }
 
+  // Returns the end of the run of ASCII characters, other than the
+  // null character, starting at "in".  If the size of the string is
+  // not known "stop" is before "in" and the string must be null
+  // terminated.  16 (or 32 with AVX2) bytes are checked at a time
+  // when they are known to be part of the string or the load can not
+  // cross into the next page.
+  static inline const char * skip_ascii(const char * in, const char * stop)
+  {
+    const bool bounded = stop >= in;
+#if defined(__AVX2__)
+    while (bounded ? stop - in >= 32 : ((size_t)in & 4095) <= 4096 - 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)in);
+      unsigned end = _mm256_movemask_epi8(x)
+        | _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+      if (end) return in + __builtin_ctz(end);
+      in += 32;
+    }
+#elif defined(__SSE2__)
+    while (bounded ? stop - in >= 16 : ((size_t)in & 4095) <= 4096 - 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *)in);
+      unsigned end = _mm_movemask_epi8(x)
+        | _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128()));
+      if (end) return in + __builtin_ctz(end);
+      in += 16;
+    }
+#endif
+    while (in != stop && (byte)(*in - 1) < 0x7F) ++in;
+    return in;
+  }
+
+  static inline void append_ascii(const char * in, const char * stop,
+                                  FilterCharVector & out)
+  {
+    size_t pos = out.size();
+    out.resize(pos + (stop - in));
+    FilterChar * o = out.pbegin() + pos;
+    for (; in != stop; ++in, ++o)
+      *o = FilterChar((byte)*in, 1);
+  }
+
   static inline void to_utf8 (FilterChar in, CharVector & out)
   {
     FilterChar::Chr c = in;
@@ -815,6 +885,12 @@ namespace aspell {
     void decode(const char * in, int size, FilterCharVector & out) const {
       const char * stop = in + size; // this is OK even if size == -1
       while (in != stop && *in) {
+        const char * end = skip_ascii(in, stop);
+        if (end != in) {
+          append_ascii(in, end, out);
+          in = end;
+          continue;
+        }
         out.append(from_utf8(in, stop));
       }
     }
@@ -823,6 +899,12 @@ namespace aspell {
       const char * begin = in;
       const char * stop = in + size; // this is OK even if size == -1
       while (in != stop && *in) {
+        const char * end = skip_ascii(in, stop);
+        if (end != in) {
+          append_ascii(in, end, out);
+          in = end;
+          continue;
+        }
         FilterChar c = from_utf8(in, stop, (Uni32)-1);
         if (c == (Uni32)-1) {
           char m[70];
@@ -840,15 +922,24 @@ namespace aspell {
     FromUniLookup lookup;
     void encode(const FilterChar * in, const FilterChar * stop, 
                 CharVector & out) const {
-      for (; in != stop; ++in) {
-        to_utf8(*in, out);
+      while (in != stop) {
+        const FilterChar * end = in;
+        while (end != stop && end->chr < 0x80) ++end;
+        if (end != in) {
+          size_t pos = out.size();
+          out.resize(pos + (end - in));
+          char * o = out.data() + pos;
+          for (; in != end; ++in, ++o)
+            *o = static_cast<char>(in->chr);
+        } else {
+          to_utf8(*in, out);
+          ++in;
+        }
       }
     }
     PosibErr<void> encode_ec(const FilterChar * in, const FilterChar * stop, 
                              CharVector & out, ParmStr) const {
-      for (; in != stop; ++in) {
-        to_utf8(*in, out);
-      }
+      EncodeUtf8::encode(in, stop, out);
       return no_err;
     }
     void encode(const FilterChar * in, const FilterChar * stop, 
@@ -857,6 +948,132 @@ namespace aspell {
     }
   };
 
+  //////////////////////////////////////////////////////////////////////
+  //
+  // Direct UTF-8 <-> 8-bit Conversion
+  //
+
+  // These convert between UTF-8 and an 8-bit character set in a
+  // single pass without first decoding into FilterChars.  They use
+  // the tables of the Decode or Encode object for the 8-bit side, and
+  // give exactly the same result as decoding and then encoding.
+
+  struct ConvUtf8ToBytes : public DirectConv
+  {
+    const FromUniLookup * lookup; // null for iso-8859-1
+    bool ascii; // true if ASCII characters map to themselves
+    char to_byte(Uni32 c, char unknown) const {
+      if (lookup) return (*lookup)(c, unknown);
+      return c < 0x100 ? static_cast<char>(c) : unknown;
+    }
+    PosibErr<void> init(const Decode *, const Encode * e, const Config &) {
+      lookup = e->key == "iso-8859-1"
+        ? 0 : &static_cast<const EncodeLookup *>(e)->lookup;
+      ascii = true;
+      for (Uni32 c = 1; c != 0x80 && ascii; ++c)
+        ascii = to_byte(c, '\0') == static_cast<char>(c);
+      return no_err;
+    }
+    void convert(const char * in, int size, CharVector & out) const {
+      const char * stop = in + size; // this is OK even if size == -1
+      while (in != stop && *in) {
+        if (ascii) {
+          const char * end = skip_ascii(in, stop);
+          if (end != in) {
+            out.append(in, end - in);
+            in = end;
+            continue;
+          }
+        }
+        out.append(to_byte(from_utf8(in, stop).chr, '?'));
+      }
+    }
+    PosibErr<void> convert_ec(const char * in, int size,
+                              CharVector & out, ParmStr orig) const {
+      const char * begin = in;
+      const char * stop = in + size; // this is OK even if size == -1
+      // an invalid sequence is reported in favor of an unsupported
+      // character that comes before it, as the string is not known
+      // to be valid UTF-8 until all of it has been seen
+      Uni32 unsupported = 0;
+      while (in != stop && *in) {
+        if (ascii) {
+          const char * end = skip_ascii(in, stop);
+          if (end != in) {
+            if (!unsupported) out.append(in, end - in);
+            in = end;
+            continue;
+          }
+        }
+        Uni32 u = from_utf8(in, stop, (Uni32)-1).chr;
+        if (u == (Uni32)-1) {
+          char m[70];
+          snprintf(m, 70, _("Invalid UTF-8 sequence at position %ld."), (long)(in - begin));
+          return make_err(invalid_string, orig, m);
+        }
+        if (unsupported) continue;
+        char c = to_byte(u, '\0');
+        if (c == '\0') unsupported = u;
+        else           out.append(c);
+      }
+      if (unsupported) {
+        char m[70];
+        snprintf(m, 70, _("The Unicode code point U+%04X is unsupported."), unsupported);
+        return make_err(invalid_string, orig, m);
+      }
+      return no_err;
+    }
+  };
+
+  struct ConvBytesToUtf8 : public DirectConv
+  {
+    struct Seq {
+      char str[4];
+      unsigned char size;
+    };
+    Seq to_utf8_[256];
+    bool ascii; // true if ASCII characters map to themselves
+    PosibErr<void> init(const Decode * d, const Encode *, const Config &) {
+      const DecodeLookup * dl = d->key == "iso-8859-1"
+        ? 0 : static_cast<const DecodeLookup *>(d);
+      CharVector buf;
+      ascii = true;
+      for (unsigned i = 0; i != 256; ++i) {
+        Uni32 u = dl ? dl->lookup[static_cast<char>(i)] : i;
+        buf.clear();
+        // characters not in the set have no code point and give an
+        // empty sequence
+        to_utf8(FilterChar(u), buf);
+        to_utf8_[i].size = buf.size();
+        memcpy(to_utf8_[i].str, buf.data(), buf.size());
+        if (i != 0 && i < 0x80 && u != i) ascii = false;
+      }
+      return no_err;
+    }
+    void convert(const char * in, int size, CharVector & out) const {
+      const char * stop = in + size; // this is OK even if size == -1
+      while (in != stop) {
+        if (ascii) {
+          const char * end = skip_ascii(in, stop);
+          if (end != in) {
+            out.append(in, end - in);
+            in = end;
+            continue;
+          }
+        }
+        if (*in == 0 && size == -1) break;
+        const Seq & s = to_utf8_[static_cast<byte>(*in)];
+        out.append(s.str, s.size);
+        ++in;
+      }
+    }
+    PosibErr<void> convert_ec(const char * in, int size,
+                              CharVector & out, ParmStr) const {
+      ConvBytesToUtf8::convert(in, size, out);
+      return no_err;
+    }
+  };
+
   //////////////////////////////////////////////////////////////////////
   //
   // Cache
@@ -1205,6 +1422,10 @@ namespace aspell {
       } else {
         conv_ = new ConvDirect<char>;
       }
+    } else if (in == "utf-8" && out != "ucs-2" && out != "ucs-4") {
+      conv_ = new ConvUtf8ToBytes;
+    } else if (out == "utf-8" && in != "ucs-2" && in != "ucs-4") {
+      conv_ = new ConvBytesToUtf8;
     }
 
     if (conv_)
@@ -50,13 +50,70 @@ namespace aspell {
       (*cur)->reset();
   }
 
+  // the approximate number of characters passed at a time to a group
+  // of filters that work in place
+  static const int filter_block_size = 4096;
+
   void Filter::process(FilterChar * & start, FilterChar * & stop)
+  {
+    Filters::iterator cur, end;
+    cur = filters_.begin();
+    end = filters_.end();
+    while (cur != end) {
+      Filters::iterator group_end = cur;
+      while (group_end != end && (*group_end)->in_place()) ++group_end;
+      if (group_end - cur > 1 && stop - start > filter_block_size) {
+        process_in_blocks(cur, group_end, start, stop);
+        cur = group_end;
+      } else {
+        (*cur)->process(start, stop);
+        ++cur;
+      }
+    }
+  }
+
+  // Rather than making a pass over the whole string for each filter,
+  // run all of [cur, end) on one block of it before moving on to the
+  // next.  Blocks end just before a newline so that a filter sees the
+  // same thing it would if the document was checked a line at a time.
+  void Filter::process_in_blocks(Filters::iterator cur, Filters::iterator end,
+                                 FilterChar * start, FilterChar * stop)
+  {
+    while (start != stop) {
+      FilterChar * block_stop = stop;
+      if (stop - start > filter_block_size) {
+        block_stop = start + filter_block_size;
+        while (block_stop != stop && *block_stop != '\n') ++block_stop;
+      }
+      FilterChar next = *block_stop;
+      *block_stop = 0;
+      for (Filters::iterator i = cur; i != end; ++i) {
+        FilterChar * b = start, * e = block_stop;
+        (*i)->process(b, e);
+        assert(b == start && e == block_stop);
+      }
+      *block_stop = next;
+      start = block_stop;
+    }
+  }
+
+  bool Filter::save_state(String & buf) const
+  {
+    Filters::const_iterator cur, end;
+    cur = filters_.begin();
+    end = filters_.end();
+    for (; cur != end; ++cur)
+      if (!(*cur)->save_state(buf)) return false;
+    return true;
+  }
+
+  void Filter::restore_state(const char * state)
   {
     Filters::iterator cur, end;
     cur = filters_.begin();
     end = filters_.end();
     for (; cur != end; ++cur)
-      (*cur)->process(start, stop);
+      (*cur)->restore_state(state);
   }
 
   void Filter::clear()
@@ -155,6 +212,7 @@ namespace aspell {
   //
 
   IndividualFilter::IndividualFilter()
+    : in_place_(false)
   {
   }
 
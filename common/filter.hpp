@@ -19,6 +19,7 @@
 namespace aspell {
 
   class Config;
+  class String;
   class Speller;
   class IndividualFilter;
   class StringList;
@@ -31,6 +32,9 @@ namespace aspell {
     void clear();
     void reset();
     void process(FilterChar * & start, FilterChar * & stop);
+    // see IndividualFilter::save_state
+    bool save_state(String & buf) const;
+    void restore_state(const char * state);
     void add_filter(IndividualFilter * filter, bool own = true);
 
     // 
@@ -45,6 +49,9 @@ namespace aspell {
     Filters filters_;
     Filters own_;
 
+    void process_in_blocks(Filters::iterator cur, Filters::iterator end,
+                           FilterChar * start, FilterChar * stop);
+
   public:
 
     typedef Filters::const_iterator Iterator;
@@ -0,0 +1,164 @@
+// This file is part of The New Aspell
+// Copyright (C) 2026 under the GNU LGPL license version 2.0 or 2.1.
+// You should have received a copy of the LGPL license along with this
+// library if you did not you can find it at http://www.gnu.org/.
+
+#include <string.h>
+
+#include "incremental_checker.hpp"
+#include "errors.hpp"
+#include "gettext.h"
+
+namespace aspell {
+
+  IncrementalChecker::IncrementalChecker(Checker * c)
+    : checker_(c), size_(0), dirty_(false)
+  {
+    String state;
+    checker_->reset();
+    stateful_ = checker_->save_filter_state(state);
+    set_document("", 0);
+  }
+
+  IncrementalChecker::~IncrementalChecker()
+  {
+    clear();
+  }
+
+  void IncrementalChecker::clear()
+  {
+    for (Lines::iterator i = lines_.begin(); i != lines_.end(); ++i)
+      delete *i;
+    lines_.clear();
+  }
+
+  // Appends the lines of "str" to "out".  The last one holds what
+  // comes after the last newline and may be empty.
+  void IncrementalChecker::split(const char * str, unsigned size, Lines & out)
+  {
+    const char * stop = str + size;
+    for (;;) {
+      const char * eol
+        = static_cast<const char *>(memchr(str, '\n', stop - str));
+      Line * line = new Line;
+      out.push_back(line);
+      if (!eol) {
+        line->text.assign(str, stop - str);
+        break;
+      }
+      line->text.assign(str, eol + 1 - str);
+      str = eol + 1;
+    }
+  }
+
+  void IncrementalChecker::set_document(const char * str, unsigned size)
+  {
+    clear();
+    split(str, size, lines_);
+    checker_->reset();
+    if (stateful_) checker_->save_filter_state(lines_[0]->state);
+    size_ = size;
+    dirty_ = true;
+  }
+
+  PosibErr<void> IncrementalChecker::edit(unsigned offset, unsigned removed,
+                                          const char * str, unsigned size)
+  {
+    if (offset > size_ || removed > size_ - offset)
+      return make_err(other_error,
+                      _("The edit is outside of the document."));
+    unsigned end = offset + removed;
+
+    // find the line the edit starts in and the one holding the first
+    // character after it
+    Lines::iterator first = lines_.begin();
+    unsigned first_start = 0;
+    while (first + 1 != lines_.end()
+           && first_start + (*first)->text.size() <= offset) {
+      first_start += (*first)->text.size();
+      ++first;
+    }
+    Lines::iterator last = first;
+    unsigned last_start = first_start;
+    while (last + 1 != lines_.end()
+           && last_start + (*last)->text.size() <= end) {
+      last_start += (*last)->text.size();
+      ++last;
+    }
+    bool at_end = last + 1 == lines_.end();
+
+    String text;
+    text.append((*first)->text.str(), offset - first_start);
+    text.append(str, size);
+    text.append((*last)->text.str() + (end - last_start),
+                last_start + (*last)->text.size() - end);
+
+    Lines repl;
+    split(text.str(), text.size(), repl);
+    // unless the edit reaches the last line the text ends with a
+    // newline, so the empty line split adds after it is not wanted
+    if (!at_end) {
+      delete repl.back();
+      repl.pop_back();
+    }
+    // the lines before are not changed so neither is the state at
+    // the start of the first one
+    repl[0]->state = (*first)->state;
+
+    ++last;
+    for (Lines::iterator i = first; i != last; ++i)
+      delete *i;
+    Lines::iterator pos = lines_.erase(first, last);
+    lines_.insert(pos, repl.begin(), repl.end());
+
+    size_ = size_ - removed + size;
+    dirty_ = true;
+    return no_err;
+  }
+
+  void IncrementalChecker::check_line(Line & line, String & next_state)
+  {
+    checker_->reset();
+    if (stateful_) checker_->restore_filter_state(line.state.str());
+    checker_->process(line.text.str(), line.text.size());
+    line.misspellings.clear();
+    const CheckerToken * tok;
+    while ((tok = checker_->next_misspelling()) != 0) {
+      Misspelling m;
+      m.offset = tok->begin.offset;
+      m.len    = tok->end.offset - tok->begin.offset;
+      line.misspellings.push_back(m);
+    }
+    line.dirty = false;
+    next_state.clear();
+    if (stateful_) checker_->save_filter_state(next_state);
+  }
+
+  void IncrementalChecker::update()
+  {
+    if (!dirty_) return;
+    misspellings_.clear();
+    String next_state;
+    bool prev_checked = false;
+    unsigned start = 0;
+    for (Lines::iterator i = lines_.begin(); i != lines_.end(); ++i) {
+      Line & line = **i;
+      if (prev_checked && (!stateful_ || line.state != next_state)) {
+        line.state = next_state;
+        line.dirty = true;
+      }
+      prev_checked = line.dirty;
+      if (line.dirty)
+        check_line(line, next_state);
+      Vector<Misspelling>::const_iterator j = line.misspellings.begin();
+      for (; j != line.misspellings.end(); ++j) {
+        Misspelling m = *j;
+        m.offset += start;
+        misspellings_.push_back(m);
+      }
+      start += line.text.size();
+    }
+    dirty_ = false;
+  }
+
+}
@@ -0,0 +1,90 @@
+// This file is part of The New Aspell
+// Copyright (C) 2026 under the GNU LGPL license version 2.0 or 2.1.
+// You should have received a copy of the LGPL license along with this
+// library if you did not you can find it at http://www.gnu.org/.
+
+#ifndef ASPELL_INCREMENTAL_CHECKER__HPP
+#define ASPELL_INCREMENTAL_CHECKER__HPP
+
+#include "can_have_error.hpp"
+#include "checker.hpp"
+#include "posib_err.hpp"
+#include "stack_ptr.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace aspell {
+
+  class Speller;
+
+  // A document which is kept checked while it is being edited, for
+  // use by editors.  The document is split into lines and for each
+  // line the misspelled words in it and the state of the filters at
+  // its start are remembered.  After an edit only the lines that
+  // changed are checked again, together with any lines following
+  // them whose filter state at the start is now different, for
+  // example because a comment was opened or closed.  If a filter
+  // does not support saving its state every line after an edit is
+  // checked again.
+  //
+  // Offsets and sizes are in bytes of the document, which is in the
+  // encoding of the speller.
+
+  class IncrementalChecker : public CanHaveError {
+  public:
+    struct Misspelling {
+      unsigned offset;
+      unsigned len;
+    };
+
+    IncrementalChecker(Checker *); // takes ownership
+    ~IncrementalChecker();
+
+    // replaces the whole document
+    void set_document(const char * str, unsigned size);
+
+    // replaces the "removed" bytes at "offset" with "str"; nothing is
+    // checked until the misspellings are asked for, so it is cheap to
+    // apply several edits in a row
+    PosibErr<void> edit(unsigned offset, unsigned removed,
+                        const char * str, unsigned size);
+
+    unsigned size() const {return size_;}
+
+    // the misspellings in the document, in order
+    unsigned misspelling_count() {update(); return misspellings_.size();}
+    Misspelling misspelling(unsigned i) {update(); return misspellings_[i];}
+
+  private:
+    IncrementalChecker(const IncrementalChecker &);
+    void operator= (const IncrementalChecker &);
+
+    struct Line {
+      String text;  // including the newline at the end
+      String state; // of the filters at the start of the line
+      Vector<Misspelling> misspellings; // relative to the line
+      bool dirty;
+      Line() : dirty(true) {}
+    };
+    // every line but the last ends with a newline, the last line
+    // has none and may be empty
+    typedef Vector<Line *> Lines;
+
+    StackPtr<Checker> checker_;
+    bool stateful_; // true if the filter state can be saved
+    Lines lines_;
+    unsigned size_;
+    bool dirty_;
+    Vector<Misspelling> misspellings_;
+
+    void clear();
+    void split(const char * str, unsigned size, Lines & out);
+    void check_line(Line &, String & next_state);
+    void update();
+  };
+
+  PosibErr<IncrementalChecker *> new_incremental_checker(Speller *);
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 #define ACOMMON_FILTER__HPP
 
 #include <assert.h>
+#include <string.h>
 
 #include "string.hpp"
 #include "posib_err.hpp"
@@ -85,8 +86,27 @@ namespace aspell {
     //   strlen == stop - start;
     // this way it is always safe to look one character ahead.
     //
+    // If the filter only ever blanks out or otherwise changes
+    // characters of the string passed in, and never changes start or
+    // stop, it should say so by calling set_in_place when it is set
+    // up.  Filter::process is then free to pass in a long string in
+    // pieces which end just before a newline, so that the pieces are
+    // processed by all such filters in turn while they are still in
+    // the cache.
     virtual void process(FilterChar * & start, FilterChar * & stop) = 0;
 
+    // save and restore the internal state of the filter
+    //
+    // save_state should append everything that process and reset may
+    // change to the buffer, so that passing it to restore_state later on puts
+    // the filter back in the same state.  Two states should compare
+    // equal if and only if the filter will behave the same way in
+    // both.  It should return false, which is the default, if this is
+    // not supported.  restore_state should advance the pointer past
+    // what save_state appended.
+    virtual bool save_state(String &) const {return false;}
+    virtual void restore_state(const char * &) {}
+
     virtual ~IndividualFilter() {}
 
     const char * name() const {return name_.str();}
@@ -96,12 +116,15 @@ namespace aspell {
     enum What {Encoder, Filter, Decoder};
     What what() const {return what_;}
 
+    bool in_place() const {return in_place_;}
+
     FilterHandle handle;
 
   protected:
     // set the name and type of filter, after called base_name, name,
     // and what will be defined
     void set_order_num(double on) {order_num_ = on;}
+    void set_in_place() {in_place_ = true;}
 
   private:
     // IndividualFilter should not be inherited from except for 
@@ -112,6 +135,7 @@ namespace aspell {
     String name_;
     double order_num_; // between 0 and 1 exclusive
     What what_;        // an encoder, filter, or decoder?
+    bool in_place_;    // see process
   };
 
   class NormalFilter : public IndividualFilter {
@@ -124,12 +148,46 @@ namespace aspell {
   // allowed to use an internal buffer, therefore "process" is still not
   // thread safe or const
   class ConversionFilter : public IndividualFilter {
+  public:
+    bool save_state(String &) const {return true;}
+    void restore_state(const char * &) {}
   protected:
     ConversionFilter() {}
     void set_name(ParmStr name, What);
     
   };
 
+  // helpers for implementing IndividualFilter::save_state and
+  // restore_state
+
+  template <typename T>
+  static inline void save_filter_state(String & buf, const T & v)
+  {
+    buf.append(&v, sizeof(T));
+  }
+
+  static inline void save_filter_state(String & buf, const String & v)
+  {
+    unsigned size = v.size();
+    save_filter_state(buf, size);
+    buf.append(v.str(), size);
+  }
+
+  template <typename T>
+  static inline void restore_filter_state(const char * & state, T & v)
+  {
+    memcpy(&v, state, sizeof(T));
+    state += sizeof(T);
+  }
+
+  static inline void restore_filter_state(const char * & state, String & v)
+  {
+    unsigned size;
+    restore_filter_state(state, size);
+    v.assign(state, size);
+    state += size;
+  }
+
 }
 
 #endif
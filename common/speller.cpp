@@ -51,5 +51,7 @@ namespace aspell {
   Speller::Speller(SpellerLtHandle h) : lt_handle_(h) {}
 
   Speller::~Speller() {}
+
+  CheckContext::~CheckContext() {}
 }
 
@@ -34,6 +34,7 @@ namespace aspell {
   class Filter;
   class DocumentChecker;
   class Checker;
+  class CheckContext;
 
   struct IntrCheckInfo {
     mutable CheckInfo ext; // Stuff that is used by the C interface
@@ -98,6 +99,21 @@ namespace aspell {
 
     virtual Checker * new_checker() = 0;
 
+    // Like new_checker, but words are checked using "ctx", which the
+    // checker takes ownership of.  Use new_thread_checker instead.
+    virtual Checker * new_checker(CheckContext * ctx) = 0;
+
+    // Freezes the speller so that it can be shared by several
+    // threads, each checking words with its own CheckContext.  Once
+    // frozen the word lists can no longer be changed and neither can
+    // the config.  The speller itself is still not thread safe.
+    virtual PosibErr<void> freeze() = 0;
+    virtual bool frozen() const = 0;
+
+    // Use new_check_context instead, this does not set up the
+    // converter used by the C interface.
+    virtual CheckContext * new_check_context() const = 0;
+
     ////////////////////////////////////////////////////////////////
     // 
     // Strings from this point on are expected to be in the 
@@ -106,6 +122,13 @@ namespace aspell {
 
     virtual PosibErr<bool> check(MutableString) = 0;
 
+    // checks num words at once setting res[i] to the result of
+    // check(words[i]), the lookups are grouped together so that this
+    // is faster than checking the words one at a time.  The info
+    // returned by intr_check_info is not valid afterwards.
+    virtual PosibErr<void> check_words(MutableString * words, unsigned num,
+                                       unsigned char * res) = 0;
+
     // this function return information about the last word checked
     // The "ext" part of the struct is not filled in.  For that
     // use check_info()
@@ -134,6 +157,10 @@ namespace aspell {
   
     virtual PosibErr<void> clear_session() = 0;
 
+    // starts bringing the dictionaries into memory in the background
+    // so that the first words checked do not have to wait for them
+    virtual PosibErr<void> warm() = 0;
+
     virtual PosibErr<const WordList *> suggest(MutableString) = 0;
     // return null on error
     // the word list returned by suggest is only valid until the next
@@ -151,6 +178,25 @@ namespace aspell {
   };
 
 
+  // The state needed to check words with a frozen speller.  Each
+  // thread uses its own context, they are cheap to create.  The
+  // speller must outlive its contexts.
+  class CheckContext : public CanHaveError
+  {
+  public:
+    String temp_str_0;
+    ClonePtr<FullConvert> to_internal_;
+
+    virtual PosibErr<bool> check(MutableString) = 0;
+    virtual const IntrCheckInfo * intr_check_info() = 0;
+
+    virtual ~CheckContext();
+  };
+
+  // returns an error if the speller is not frozen
+  PosibErr<CheckContext *> new_check_context(Speller *);
+
+
   // This function is current a hack to reload the filters in the
   // speller class.  I hope to eventually find a better way.
   PosibErr<void> reload_filters(Speller * m);
@@ -0,0 +1,206 @@
+// This file is part of The New Aspell
+// Copyright (C) 2026 under the GNU LGPL license version 2.0 or 2.1.
+// You should have received a copy of the LGPL license along with this
+// library if you did not you can find it at http://www.gnu.org/.
+
+#include "settings.h"
+
+#include "thread.hpp"
+#include "vector.hpp"
+
+#ifdef USE_POSIX_THREADS
+#  include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+
+namespace aspell {
+
+  namespace {
+
+#ifdef USE_POSIX_THREADS
+    extern "C" void * run_pool_thread(void * p);
+
+    extern "C" void * run_task_thread(void * t)
+    {
+      static_cast<Task *>(t)->run();
+      return 0;
+    }
+#endif
+
+  }
+
+  void run_parallel(Task * const * begin, Task * const * end,
+                    unsigned num_threads)
+  {
+    ThreadPool pool;
+    pool.run(begin, end, num_threads);
+  }
+
+#ifdef USE_POSIX_THREADS
+  namespace {
+
+    //
+    // The tasks of the current call to "run" are [cur, end).  Pool
+    // threads wait on "work" until there are tasks and a free "helpers"
+    // slot, the thread that called "run" waits on "done" until the pool
+    // threads that took part ("busy") are finished.
+    //
+    struct Pool {
+      pthread_mutex_t   lock;
+      pthread_cond_t    work;
+      pthread_cond_t    done;
+      Vector<pthread_t> threads;
+      Task * const *    cur;
+      Task * const *    end;
+      unsigned          helpers;
+      unsigned          busy;
+      bool              running;
+      bool              stop;
+      Pool() : cur(0), end(0), helpers(0), busy(0), running(false), stop(false) {
+        pthread_mutex_init(&lock, 0);
+        pthread_cond_init(&work, 0);
+        pthread_cond_init(&done, 0);
+      }
+      ~Pool() {
+        pthread_mutex_lock(&lock);
+        stop = true;
+        pthread_cond_broadcast(&work);
+        pthread_mutex_unlock(&lock);
+        for (Vector<pthread_t>::iterator i = threads.begin();
+             i != threads.end(); ++i)
+          pthread_join(*i, 0);
+        pthread_cond_destroy(&done);
+        pthread_cond_destroy(&work);
+        pthread_mutex_destroy(&lock);
+      }
+      // runs the remaining tasks, must be called with the lock held
+      void run_tasks() {
+        while (cur != end) {
+          Task * t = *cur++;
+          pthread_mutex_unlock(&lock);
+          t->run();
+          pthread_mutex_lock(&lock);
+        }
+      }
+      void thread_main() {
+        pthread_mutex_lock(&lock);
+        for (;;) {
+          while (!stop && (cur == end || helpers == 0))
+            pthread_cond_wait(&work, &lock);
+          if (stop) break;
+          --helpers;
+          ++busy;
+          run_tasks();
+          if (--busy == 0) pthread_cond_signal(&done);
+        }
+        pthread_mutex_unlock(&lock);
+      }
+      bool run(Task * const * b, Task * const * e, unsigned num_threads) {
+        pthread_mutex_lock(&lock);
+        if (running) {
+          pthread_mutex_unlock(&lock);
+          return false;
+        }
+        running = true;
+        cur = b;
+        end = e;
+        helpers = num_threads - 1;
+        // if a thread can not be created the tasks will still be run
+        // by the threads that were
+        while (threads.size() < helpers) {
+          pthread_t t;
+          if (pthread_create(&t, 0, run_pool_thread, this) != 0) break;
+          threads.push_back(t);
+        }
+        pthread_cond_broadcast(&work);
+        run_tasks();
+        while (busy != 0)
+          pthread_cond_wait(&done, &lock);
+        helpers = 0;
+        running = false;
+        pthread_mutex_unlock(&lock);
+        return true;
+      }
+    };
+
+    extern "C" void * run_pool_thread(void * p)
+    {
+      static_cast<Pool *>(p)->thread_main();
+      return 0;
+    }
+
+  }
+
+  struct ThreadPool::Impl : public Pool {};
+#endif
+
+  // The lock that keeps the pool from being used by two threads at
+  // once is part of Impl so it is created here rather than when first
+  // needed.
+  ThreadPool::ThreadPool() : impl_(0)
+  {
+#ifdef USE_POSIX_THREADS
+    impl_ = new Impl;
+#endif
+  }
+
+  void ThreadPool::run(Task * const * begin, Task * const * end,
+                       unsigned num_threads)
+  {
+    if ((unsigned)(end - begin) < num_threads)
+      num_threads = end - begin;
+#ifdef USE_POSIX_THREADS
+    if (num_threads > 1 && impl_->run(begin, end, num_threads))
+      return;
+#endif
+    for (; begin != end; ++begin)
+      (*begin)->run();
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+#ifdef USE_POSIX_THREADS
+    delete impl_;
+#endif
+  }
+
+#ifdef USE_POSIX_THREADS
+  struct Thread::Impl {
+    pthread_t thread;
+  };
+#endif
+
+  void Thread::start(Task * t)
+  {
+    join();
+#ifdef USE_POSIX_THREADS
+    impl_ = new Impl;
+    if (pthread_create(&impl_->thread, 0, run_task_thread, t) == 0) return;
+    delete impl_;
+    impl_ = 0;
+#endif
+    t->run();
+  }
+
+  void Thread::join()
+  {
+#ifdef USE_POSIX_THREADS
+    if (!impl_) return;
+    pthread_join(impl_->thread, 0);
+    delete impl_;
+    impl_ = 0;
+#endif
+  }
+
+  unsigned num_processors()
+  {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return n;
+#endif
+    return 1;
+  }
+
+}
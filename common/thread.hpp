@@ -0,0 +1,70 @@
+// This file is part of The New Aspell
+// Copyright (C) 2026 under the GNU LGPL license version 2.0 or 2.1.
+// You should have received a copy of the LGPL license along with this
+// library if you did not you can find it at http://www.gnu.org/.
+
+#ifndef ASPELL_THREAD__HPP
+#define ASPELL_THREAD__HPP
+
+namespace aspell {
+
+  // A unit of work for run_parallel.  "run" is called exactly once
+  // and possibly from a thread other than the one that created the
+  // task, thus it must not touch anything that is not safe to share.
+  class Task {
+  public:
+    virtual void run() = 0;
+    virtual ~Task() {}
+  };
+
+  // Runs all the tasks in [begin, end) using at most num_threads
+  // threads, including the calling thread, and returns once every
+  // task has finished.  Idle threads take the next task that has not
+  // been started yet so a single long task will not hold up the rest.
+  // If threads are not supported, or num_threads <= 1, the tasks are
+  // simply run in order by the calling thread.
+  void run_parallel(Task * const * begin, Task * const * end,
+                    unsigned num_threads);
+
+  // Keeps the threads used to run tasks around so that they don't
+  // need to be created for every call.  "run" is like run_parallel
+  // except that the other threads come from the pool.  They are
+  // created the first time they are needed and stopped when the pool
+  // is destroyed.  If the pool is already running tasks for another
+  // thread the calling thread simply runs its tasks itself.
+  class ThreadPool {
+  public:
+    ThreadPool();
+    ~ThreadPool();
+    void run(Task * const * begin, Task * const * end,
+             unsigned num_threads);
+  private:
+    struct Impl;
+    Impl * impl_;
+    ThreadPool(const ThreadPool &);
+    void operator=(const ThreadPool &);
+  };
+
+  // Runs a task in a thread of its own.  "join" waits for the task to
+  // finish and is also called by the destructor.  If threads are not
+  // supported, or the thread can not be created, "start" simply runs
+  // the task before returning.
+  class Thread {
+  public:
+    Thread() : impl_(0) {}
+    ~Thread() {join();}
+    void start(Task *);
+    void join();
+  private:
+    struct Impl;
+    Impl * impl_;
+    Thread(const Thread &);
+    void operator=(const Thread &);
+  };
+
+  // Returns the number of processors online, or 1 if unknown.
+  unsigned num_processors();
+
+}
+
+#endif
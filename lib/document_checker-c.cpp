@@ -4,8 +4,11 @@
  * LGPL license along with this library if you did not you can find it
  * at http://www.gnu.org/.                                              */
 
+#include <string.h>
+
 #include "checker.hpp"
 #include "error.hpp"
+#include "incremental_checker.hpp"
 
 namespace aspell {
 
@@ -79,7 +82,72 @@ extern "C" Token aspell_document_checker_next_misspelling(DocumentChecker * ths)
   return tok;
 }
 
+extern "C" void delete_aspell_incremental_checker(IncrementalChecker * ths)
+{
+  delete ths;
+}
+
+extern "C" unsigned int aspell_incremental_checker_error_number(const IncrementalChecker * ths)
+{
+  return ths->err_ == 0 ? 0 : 1;
+}
+
+extern "C" const char * aspell_incremental_checker_error_message(const IncrementalChecker * ths)
+{
+  return ths->err_ ? ths->err_->mesg : "";
+}
+
+extern "C" const Error * aspell_incremental_checker_error(const IncrementalChecker * ths)
+{
+  return ths->err_;
+}
+
+extern "C" CanHaveError * new_aspell_incremental_checker(Speller * speller)
+{
+  PosibErr<IncrementalChecker *> ret = new_incremental_checker(speller);
+  if (ret.has_err()) {
+    return new CanHaveError(ret.release_err());
+  } else {
+    return ret.data;
+  }
+}
+
+extern "C" IncrementalChecker * to_aspell_incremental_checker(CanHaveError * obj)
+{
+  return static_cast<IncrementalChecker *>(obj);
+}
+
+extern "C" void aspell_incremental_checker_set_document(IncrementalChecker * ths, const char * str, int size)
+{
+  ths->set_document(str, size < 0 ? strlen(str) : size);
+}
+
+extern "C" int aspell_incremental_checker_edit(IncrementalChecker * ths, unsigned int offset, unsigned int removed, const char * str, int size)
+{
+  PosibErr<void> ret = ths->edit(offset, removed, str, size < 0 ? strlen(str) : size);
+  ths->err_.reset(ret.release_err());
+  if (ths->err_ != 0) return 0;
+  return 1;
+}
+
+extern "C" unsigned int aspell_incremental_checker_misspelling_count(IncrementalChecker * ths)
+{
+  return ths->misspelling_count();
+}
 
+extern "C" Token aspell_incremental_checker_misspelling(IncrementalChecker * ths, unsigned int i)
+{
+  Token tok;
+  if (i < ths->misspelling_count()) {
+    IncrementalChecker::Misspelling m = ths->misspelling(i);
+    tok.offset = m.offset;
+    tok.len    = m.len;
+  } else {
+    tok.offset = 0;
+    tok.len = 0;
+  }
+  return tok;
+}
 
 }
 
@@ -6,8 +6,11 @@
 
 #include "speller.hpp"
 #include "checker.hpp"
+#include "incremental_checker.hpp"
 #include "stack_ptr.hpp"
 #include "convert.hpp"
+#include "errors.hpp"
+#include "gettext.h"
 
 namespace aspell {
 
@@ -22,4 +25,42 @@ namespace aspell {
     return checker.release();
   }
 
+  PosibErr<Checker *> 
+  new_thread_checker(Speller * speller)
+  {
+    RET_ON_ERR_SET(new_check_context(speller), CheckContext *, ctx);
+    StackPtr<Checker> checker(speller->new_checker(ctx));
+    StackPtr<Filter> filter(ctx->to_internal_->shallow_copy_filter());
+    setup_filter(*filter, speller->config(), true, true, false);
+    checker->set_filter(filter.release());
+    checker->reset();
+    return checker.release();
+  }
+
+  PosibErr<IncrementalChecker *>
+  new_incremental_checker(Speller * speller)
+  {
+    RET_ON_ERR_SET(new_checker(speller), Checker *, checker);
+    return new IncrementalChecker(checker);
+  }
+
+  PosibErr<CheckContext *>
+  new_check_context(Speller * speller)
+  {
+    if (!speller->frozen())
+      return make_err(operation_not_supported_error,
+                      _("The speller is not frozen."));
+    StackPtr<CheckContext> ctx(speller->new_check_context());
+    // the speller's converter can't be shared as it uses internal
+    // buffers, so create a new one the same way new_speller does
+    String in, out;
+    get_base_enc(in, speller->to_internal_->in_code());
+    get_base_enc(out, speller->to_internal_->out_code());
+    RET_ON_ERR_SET(new_full_convert(*speller->config(), in, out, NormFrom),
+                   FullConvert *, conv);
+    ctx->to_internal_.reset(conv);
+    RET_ON_ERR(ctx->to_internal_->add_filters(speller->config(), true, false, false));
+    return ctx.release();
+  }
+
 }
@@ -6,6 +6,7 @@
 
 #include "convert.hpp"
 #include "speller.hpp"
+#include "vector.hpp"
 
 namespace aspell {
 
@@ -51,6 +52,37 @@ extern "C" const CheckInfo * aspell_speller_check_info(Speller * ths)
   return &ci->ext;
 }
 
+extern "C" int aspell_speller_check_words(Speller * ths, 
+                                          const char * * words, 
+                                          const int * word_sizes,
+                                          unsigned int num_words,
+                                          unsigned char * results)
+{
+  ths->err_.reset(0);
+  if (num_words == 0) return 1;
+  String & buf = ths->temp_str_0;
+  buf.clear();
+  Vector<unsigned> ends;
+  ends.reserve(num_words);
+  for (unsigned i = 0; i != num_words; ++i) {
+    ths->to_internal_->convert(words[i], word_sizes ? word_sizes[i] : -1, buf);
+    ends.push_back(buf.size());
+    buf.append('\0');
+  }
+  Vector<MutableString> ws;
+  ws.reserve(num_words);
+  char * b = buf.mstr();
+  unsigned begin = 0;
+  for (unsigned i = 0; i != num_words; ++i) {
+    ws.push_back(MutableString(b + begin, ends[i] - begin));
+    begin = ends[i] + 1;
+  }
+  PosibErr<void> ret = ths->check_words(ws.pbegin(), num_words, results);
+  ths->err_.reset(ret.release_err());
+  if (ths->err_ != 0) return 0;
+  return 1;
+}
+
 
 }
 
@@ -39,10 +39,25 @@ namespace {
     ContextFilter(void);
     virtual void reset(void);
     void process(FilterChar *& start,FilterChar *& stop);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
     virtual PosibErr<bool> setup(Config * config);
     virtual ~ContextFilter();
   };
 
+  bool ContextFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, state);
+    save_filter_state(buf, correspond);
+    return true;
+  }
+
+  void ContextFilter::restore_state(const char * & st)
+  {
+    restore_filter_state(st, state);
+    restore_filter_state(st, correspond);
+  }
+
   ContextFilter::ContextFilter(void)
   : opening(),
     closing()
@@ -58,12 +58,15 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
   };
 
   PosibErr<bool> EmailFilter::setup(Config * opts) 
   {
     set_name("email");
     set_order_num(0.85);
+    set_in_place();
     is_quote_char.conv.setup(*opts, "utf-8", "ucs-4", NormNone);
     opts->retrieve_list("f-email-quote", &is_quote_char);
     margin = opts->retrieve_int("f-email-margin");
@@ -78,6 +81,21 @@ namespace {
     n = 0;
   }
 
+  bool EmailFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, prev_newline);
+    save_filter_state(buf, in_quote);
+    save_filter_state(buf, n);
+    return true;
+  }
+
+  void EmailFilter::restore_state(const char * & state)
+  {
+    restore_filter_state(state, prev_newline);
+    restore_filter_state(state, in_quote);
+    restore_filter_state(state, n);
+  }
+
   void EmailFilter::process(FilterChar * & str, FilterChar * & end)
   {
     FilterChar * line_begin = str;
@@ -80,12 +80,15 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
   };
 
   PosibErr<bool> NroffFilter::setup(Config * opts) 
   {
     set_name("nroff");
     set_order_num(0.20);
+    set_in_place();
     reset();
     return true;
   }
@@ -99,6 +102,27 @@ namespace {
     skip_chars = 0;
   }
 
+  bool NroffFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, state);
+    save_filter_state(buf, newline);
+    save_filter_state(buf, skip_chars);
+    save_filter_state(buf, req_name);
+    save_filter_state(buf, pos);
+    save_filter_state(buf, in_request);
+    return true;
+  }
+
+  void NroffFilter::restore_state(const char * & st)
+  {
+    restore_filter_state(st, state);
+    restore_filter_state(st, newline);
+    restore_filter_state(st, skip_chars);
+    restore_filter_state(st, req_name);
+    restore_filter_state(st, pos);
+    restore_filter_state(st, in_request);
+  }
+
   bool NroffFilter::process_char(FilterChar::Chr c)
   {
     if (skip_chars)
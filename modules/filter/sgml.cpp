@@ -130,12 +130,15 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
   };
 
   PosibErr<bool> SgmlFilter::setup(Config * opts) 
   {
     set_name(which);
     set_order_num(0.35);
+    set_in_place();
     check_attribs.clear();
     skip_tags.clear();
     opts->retrieve_list("f-" + which + "-skip",  &skip_tags);
@@ -152,6 +155,31 @@ namespace {
     include_attrib = false;
   }
 
+  bool SgmlFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, in_what);
+    save_filter_state(buf, quote_val);
+    save_filter_state(buf, lookbehind);
+    save_filter_state(buf, tag_name);
+    save_filter_state(buf, attrib_name);
+    save_filter_state(buf, include_attrib);
+    save_filter_state(buf, skipall);
+    save_filter_state(buf, tag_endskip);
+    return true;
+  }
+
+  void SgmlFilter::restore_state(const char * & state)
+  {
+    restore_filter_state(state, in_what);
+    restore_filter_state(state, quote_val);
+    restore_filter_state(state, lookbehind);
+    restore_filter_state(state, tag_name);
+    restore_filter_state(state, attrib_name);
+    restore_filter_state(state, include_attrib);
+    restore_filter_state(state, skipall);
+    restore_filter_state(state, tag_endskip);
+  }
+
   // yes this should be inlines, it is only called once
   
   // RETURNS: TRUE if the caller should skip the passed char and
@@ -65,6 +65,8 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
   };
 
   //
@@ -89,6 +91,7 @@ namespace {
   {
     set_name("tex");
     set_order_num(0.35);
+    set_in_place();
 
     commands.clear();
     opts->retrieve_list("f-tex-command", &commands);
@@ -107,6 +110,36 @@ namespace {
     push_command(Parm);
   }
 
+  bool TexFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, in_comment);
+    save_filter_state(buf, prev_backslash);
+    unsigned size = stack.size();
+    save_filter_state(buf, size);
+    for (unsigned i = 0; i != size; ++i) {
+      save_filter_state(buf, stack[i].in_what);
+      save_filter_state(buf, stack[i].name);
+      // points into "commands" or to a literal, so it stays valid
+      // as long as the filter is not set up again
+      save_filter_state(buf, stack[i].do_check);
+    }
+    return true;
+  }
+
+  void TexFilter::restore_state(const char * & state)
+  {
+    restore_filter_state(state, in_comment);
+    restore_filter_state(state, prev_backslash);
+    unsigned size;
+    restore_filter_state(state, size);
+    stack.resize(size);
+    for (unsigned i = 0; i != size; ++i) {
+      restore_filter_state(state, stack[i].in_what);
+      restore_filter_state(state, stack[i].name);
+      restore_filter_state(state, stack[i].do_check);
+    }
+  }
+
 #  define top stack.back()
 
   // yes this should be inlined, it is only called once
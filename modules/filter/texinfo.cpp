@@ -50,6 +50,8 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset();
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String & buf) const;
+    void restore_state(const char * & state);
   };
 
   //
@@ -60,6 +62,7 @@ namespace {
   {
     set_name("texinfo");
     set_order_num(0.35);
+    set_in_place();
     
     to_ignore.clear();
     opts->retrieve_list("f-texinfo-ignore", &to_ignore);
@@ -87,6 +90,48 @@ namespace {
     table_stack.push_back(Table(""));
   }
 
+  bool TexInfoFilter::save_state(String & buf) const
+  {
+    save_filter_state(buf, last_command);
+    save_filter_state(buf, env_command);
+    save_filter_state(buf, env_ignore);
+    save_filter_state(buf, ignore);
+    save_filter_state(buf, in_line_command);
+    save_filter_state(buf, seen_input);
+    unsigned size = stack.size();
+    save_filter_state(buf, size);
+    for (unsigned i = 0; i != size; ++i)
+      save_filter_state(buf, stack[i].ignore);
+    size = table_stack.size();
+    save_filter_state(buf, size);
+    for (unsigned i = 0; i != size; ++i) {
+      save_filter_state(buf, table_stack[i].name);
+      save_filter_state(buf, table_stack[i].ignore_item);
+    }
+    return true;
+  }
+
+  void TexInfoFilter::restore_state(const char * & state)
+  {
+    restore_filter_state(state, last_command);
+    restore_filter_state(state, env_command);
+    restore_filter_state(state, env_ignore);
+    restore_filter_state(state, ignore);
+    restore_filter_state(state, in_line_command);
+    restore_filter_state(state, seen_input);
+    unsigned size;
+    restore_filter_state(state, size);
+    stack.resize(size);
+    for (unsigned i = 0; i != size; ++i)
+      restore_filter_state(state, stack[i].ignore);
+    restore_filter_state(state, size);
+    table_stack.resize(size, Table(""));
+    for (unsigned i = 0; i != size; ++i) {
+      restore_filter_state(state, table_stack[i].name);
+      restore_filter_state(state, table_stack[i].ignore_item);
+    }
+  }
+
   void TexInfoFilter::process(FilterChar * & str, FilterChar * & stop)
   {
     FilterChar * cur = str;
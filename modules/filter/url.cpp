@@ -16,12 +16,15 @@ namespace {
     PosibErr<bool> setup(Config *);
     void reset() {}
     void process(FilterChar * &, FilterChar * &);
+    bool save_state(String &) const {return true;}
+    void restore_state(const char * &) {}
   };
 
   PosibErr<bool> UrlFilter::setup(Config *) 
   {
     set_name("url");
     set_order_num(0.95);
+    set_in_place();
     return true;
   }
 
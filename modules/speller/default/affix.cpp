@@ -44,6 +44,17 @@
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
+#include <utility>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "settings.h"
+
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#endif
 
 //#include "iostream.hpp"
 
@@ -55,6 +66,7 @@
 #include "speller_impl.hpp"
 #include "vararray.hpp"
 #include "lsort.hpp"
+#include "file_util.hpp"
 #include "hash-t.hpp"
 
 #include "gettext.h"
@@ -62,6 +74,7 @@
 namespace aspell { namespace sp {
 
 typedef unsigned char byte;
+typedef unsigned int  u32int;
 static char EMPTY[1] = {0};
 
 //////////////////////////////////////////////////////////////////////
@@ -71,7 +84,7 @@ static char EMPTY[1] = {0};
 
 struct Conds
 {
-  char * str;
+  RelPtr<char> str;
   unsigned num;
   char conds[SETSIZE];
   char get(byte i) const {return conds[i];}
@@ -79,14 +92,14 @@ struct Conds
 
 struct AffEntry
 {
-  const char *   appnd;
-  const char *   strip;
-  const char *   flags;
-  byte           appndl;
-  byte           stripl;
-  byte           xpflgs;
-  char           achar;
-  const Conds *  conds;
+  RelPtr<const char>  appnd;
+  RelPtr<const char>  strip;
+  RelPtr<const char>  flags;
+  byte                appndl;
+  byte                stripl;
+  byte                xpflgs;
+  char                achar;
+  RelPtr<const Conds> conds;
   //unsigned int numconds;
   //char         conds[SETSIZE];
 };
@@ -95,10 +108,8 @@ struct AffEntry
   
 struct PfxEntry : public AffEntry
 {
-  PfxEntry * next;
-  PfxEntry * next_eq;
-  PfxEntry * next_ne;
-  PfxEntry * flag_next;
+  RelPtr<PfxEntry> next;
+  RelPtr<PfxEntry> flag_next;
   PfxEntry() {}
 
   bool check(const LookupInfo &, const AffixMgr * pmyMgr,
@@ -115,12 +126,10 @@ struct PfxEntry : public AffEntry
 
 struct SfxEntry : public AffEntry
 {
-  const char * rappnd; // this is set in AffixMgr::build_sfxlist
+  RelPtr<const char> rappnd; // this is set in AffixMgr::build_sfxlist
   
-  SfxEntry *   next;
-  SfxEntry *   next_eq;
-  SfxEntry *   next_ne;
-  SfxEntry *   flag_next;
+  RelPtr<SfxEntry>   next;
+  RelPtr<SfxEntry>   flag_next;
 
   SfxEntry() {}
 
@@ -136,37 +145,129 @@ struct SfxEntry : public AffEntry
   SimpleString add(SimpleString, ObjStack & buf, int limit, SimpleString) const;
 };
 
+// The affix data while the affix file is being parsed
+
+struct AffixBuild
+{
+  PfxEntry * pStart[SETSIZE];
+  SfxEntry * sStart[SETSIZE];
+  PfxEntry * pFlag[SETSIZE];
+  SfxEntry * sFlag[SETSIZE];
+  int        max_strip_f[SETSIZE];
+  int        max_strip;
+  bool       two_fold_suffix;
+  AffixBuild() {memset(this, 0, sizeof(AffixBuild));}
+};
+
+// The compiled affix data starts with this.  It is followed by the
+// entries, conditions, trie nodes and strings it points to.  Since
+// only relative pointers are used it can be written out and mmaped
+// back in as is.
+
+struct AffixImage
+{
+  RelPtr<PfxEntry> pStart0; // the 0 length prefixes
+  RelPtr<SfxEntry> sStart0; // the 0 length suffixes
+  RelPtr<PfxEntry> pFlag[SETSIZE];
+  RelPtr<SfxEntry> sFlag[SETSIZE];
+  RelPtr< AffixNode<PfxEntry> > pTrie;
+  RelPtr< AffixNode<SfxEntry> > sTrie;
+  unsigned         pRoot[SETSIZE];
+  unsigned         sRoot[SETSIZE];
+  int              max_strip_f[SETSIZE];
+  int              max_strip;
+  int              two_fold_suffix;
+};
+
+// The head of an affix image file
+
+static const char * const affix_image_check_word = "aspell affix image 1.1";
+
+struct AffixImageHead
+{
+  char   check_word[32];
+  u32int endian_check; // = 12345678
+  u32int ptr_size;     // = sizeof(void *)
+  u32int aff_size;     // the size and hash of the affix file
+  u32int aff_hash;     //   the image was compiled from
+  char   charmap[32];
+  char   encoding[32];
+  u32int head_size;
+  u32int block_size;
+  u32int image_size;   // the sizes of the structures in the block,
+  u32int pfx_size;     //   so that an image written by a build with
+  u32int sfx_size;     //   a different layout is not used
+  u32int conds_size;
+  u32int node_size;
+};
+
 //////////////////////////////////////////////////////////////////////
 //
 // Utility functions declarations
 //
 
-/* return 1 if s1 is subset of s2 */
-static bool isSubset(const char * s1, const char * s2)
+template <class T>
+struct AffixLess
 {
-  while( *s1 && (*s1 == *s2) ) {
-    s1++;
-    s2++;
-  }
-  return (*s1 == '\0');
-}
+  bool operator() (T * x, T * y) const {return strcmp(x->key(),y->key()) < 0;}
+};
 
-// return 1 if s1 (reversed) is a leading subset of end of s2
-static bool isRevSubset(const char * s1, const char * end_of_s2, int len)
+template <class T>
+struct AffixNext
 {
-  while( (len > 0) && *s1 && (*s1 == *end_of_s2) ) {
-    s1++;
-    end_of_s2--;
-    len --;
+  RelPtr<T> & operator() (T * n) const {return n->next;}
+};
+
+// maps the address of an object to the address of its copy in the
+// compiled affix data
+template <class T>
+class AddrMap
+{
+  typedef std::pair<const T *, T *> Pair;
+  Vector<Pair> map_;
+public:
+  void add(const T * from, T * to) {map_.push_back(Pair(from, to));}
+  void done() {std::sort(map_.begin(), map_.end());}
+  T * operator() (const T * from) const {
+    if (!from) return 0;
+    return std::lower_bound(map_.begin(), map_.end(), Pair(from, 0))->second;
   }
-  return (*s1 == '\0');
+};
+
+static u32int hash_data(const char * str, unsigned size)
+{
+  u32int h = 0;
+  for (unsigned i = 0; i != size; ++i)
+    h = 33*h + (byte)str[i];
+  return h;
 }
 
+// Adds the entries of the sorted list to the trie.  Since the list
+// is sorted entries with the same key follow each other.
 template <class T>
-struct AffixLess
+static void build_trie(T * list, Vector< AffixNode<T> > & trie, unsigned & root)
 {
-  bool operator() (T * x, T * y) const {return strcmp(x->key(),y->key()) < 0;}
-};
+  for (T * ptr = list; ptr; ptr = ptr->next) {
+    const byte * k = (const byte *)ptr->key();
+    unsigned * link = &root;
+    unsigned n;
+    for (;;) {
+      while (*link && trie[*link].ch != *k)
+        link = &trie[*link].sibling;
+      n = *link;
+      if (!n) {
+        AffixNode<T> node = AffixNode<T>();
+        node.ch = *k;
+        n = *link = trie.size();
+        trie.push_back(node);
+      }
+      if (!*++k) break;
+      link = &trie[n].child;
+    }
+    if (!trie[n].first) trie[n].first = ptr;
+    ++trie[n].num;
+  }
+}
 
 // struct StringLookup {
 //   struct Parms {
@@ -246,23 +347,46 @@ static void encodeit(CondsLookup &, ObjStack &,
 
 PosibErr<void> AffixMgr::setup(ParmString affpath, Conv & iconv)
 {
-  // register hash manager and load affix data from aff file
-  //cpdmin = 3;  // default value
-  max_strip_ = 0;
-  for (int i=0; i < SETSIZE; i++) {
-    pStart[i] = NULL;
-    sStart[i] = NULL;
-    pFlag[i] = NULL;
-    sFlag[i] = NULL;
-    max_strip_f[i] = 0;
+  // read in the affix file to see if there is a compiled image of it
+  // that can be used instead of parsing it
+  String aff_data;
+  {
+    FStream f;
+    RET_ON_ERR(f.open(affpath, "rb"));
+    char buf[1024 * 4];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f.c_stream())) > 0)
+      aff_data.append(buf, n);
   }
-  return parse_file(affpath, iconv);
+  aff_size = aff_data.size();
+  aff_hash = hash_data(aff_data.data(), aff_data.size());
+
+  if (!load_image(affix_image_file(affpath).str())) {
+    AffixBuild b;
+    RET_ON_ERR(parse_file(affpath, iconv, b));
+    compile(b);
+    // everything needed is now in the compiled block
+    data_buf.reset();
+    data_buf.trim();
+    affix_file = 0;
+    encoding = 0;
+  }
+
+  max_strip_ = d->max_strip;
+  two_fold_suffix = d->two_fold_suffix;
+  return no_err;
 }
 
 AffixMgr::AffixMgr(const LangImpl * l) 
-  : lang(l), data_buf(1024*16) {}
+  : lang(l), d(0), mmaped_image(0), mmaped_size(0), image_size(0), 
+    encoding(0), data_buf(1024*16), affix_file(0) {}
 
-AffixMgr::~AffixMgr() {}
+AffixMgr::~AffixMgr() 
+{
+#ifdef HAVE_MMAP
+  if (mmaped_image) munmap(mmaped_image, mmaped_size);
+#endif
+}
 
 static inline void max_(int & lhs, int rhs) 
 {
@@ -270,11 +394,9 @@ static inline void max_(int & lhs, int rhs)
 }
 
 // read in aff file and build up prefix and suffix entry objects 
-PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
+PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv,
+                                    AffixBuild & b)
 {
-  //
-  two_fold_suffix = false;
-
   // io buffers
   String buf; DataPair dp;
 
@@ -382,8 +504,8 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
         // key is strip 
         if (dp.key != "0") {
           ParmString s0(iconv(dp.key));
-          max_(max_strip_, s0.size());
-          max_(max_strip_f[(byte)achar], s0.size());
+          max_(b.max_strip, s0.size());
+          max_(b.max_strip_f[(byte)achar], s0.size());
           nptr->strip = data_buf.dup(s0);
           nptr->stripl = s0.size();
         } else {
@@ -402,7 +524,7 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
           ++f;
           dp.key.size = strlen(dp.key.str);
           nptr->flags = data_buf.dup(iconv(f));
-          two_fold_suffix = true;
+          b.two_fold_suffix = true;
           for (const char * f = nptr->flags; *f; ++f) {
             if (*f == circumfix_flag)
               nptr->xpflgs |= CIRCUMFIX;
@@ -436,7 +558,7 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
           if (cond_len < nptr->stripl || 
               memcmp(cc, nptr->strip, nptr->stripl) != 0)
             return (make_err(invalid_cond_strip, 
-                             MsgConv(lang)(cond), MsgConv(lang)(nptr->strip))
+                             MsgConv(lang)(cond), MsgConv(lang)(nptr->strip.get()))
                     .with_file(affix_file, dp.line_num));
         }
         encodeit(conds_lookup, data_buf, nptr, cond);
@@ -444,9 +566,9 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
         // now create SfxEntry or PfxEntry objects and use links to
         // build an ordered (sorted by affix string) list
         if (affix_type == 'P')
-          build_pfxlist(static_cast<PfxEntry *>(nptr));
+          build_pfxlist(b, static_cast<PfxEntry *>(nptr));
         else
-          build_sfxlist(static_cast<SfxEntry *>(nptr)); 
+          build_sfxlist(b, static_cast<SfxEntry *>(nptr)); 
       }
     }
     continue;
@@ -458,37 +580,6 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
   }
   afflst.close();
 
-  // now we can speed up performance greatly taking advantage of the 
-  // relationship between the affixes and the idea of "subsets".
-
-  // View each prefix as a potential leading subset of another and view
-  // each suffix (reversed) as a potential trailing subset of another.
-
-  // To illustrate this relationship if we know the prefix "ab" is
-  // found in the word to examine, only prefixes that "ab" is a
-  // leading subset of need be examined.  Furthermore is "ab" is not
-  // present then none of the prefixes that "ab" is is a subset need
-  // be examined.
-
-  // The same argument goes for suffix string that are reversed.
-
-  // Then to top this off why not examine the first char of the word
-  // to quickly limit the set of prefixes to examine (i.e. the
-  // prefixes to examine must be leading supersets of the first
-  // character of the word (if they exist)
- 
-  // To take advantage of this "subset" relationship, we need to add
-  // two links from entry.  One to take next if the current prefix
-  // is found (call it nexteq) and one to take next if the current
-  // prefix is not found (call it nextne).
-
-  // Since we have built ordered lists, all that remains is to
-  // properly intialize the nextne and nexteq pointers that relate
-  // them
-
-  process_pfx_order();
-  process_sfx_order();
-
   //CERR.printf("%u\n", data_buf.calc_size()/1024);
 
   return no_err;
@@ -500,7 +591,7 @@ PosibErr<void> AffixMgr::parse_file(const char * affpath, Conv & iconv)
 // both by prefix flag, and sorted by prefix string itself
 // so we need to set up two indexes
 
-PosibErr<void> AffixMgr::build_pfxlist(PfxEntry* pfxptr)
+PosibErr<void> AffixMgr::build_pfxlist(AffixBuild & b, PfxEntry* pfxptr)
 {
   PfxEntry * ptr;
   PfxEntry * ep = pfxptr;
@@ -510,16 +601,16 @@ PosibErr<void> AffixMgr::build_pfxlist(PfxEntry* pfxptr)
   const byte flg = ep->flag();
 
   // first index by flag which must exist
-  ptr = pFlag[flg];
+  ptr = b.pFlag[flg];
   ep->flag_next = ptr;
-  pFlag[flg] = ep;
+  b.pFlag[flg] = ep;
 
   // next insert the affix string, it will be sorted latter
 
   byte sp = *((const byte *)key);
-  ptr = pStart[sp];
+  ptr = b.pStart[sp];
   ep->next = ptr;
-  pStart[sp] = ep;
+  b.pStart[sp] = ep;
   return no_err;
 }
 
@@ -527,7 +618,7 @@ PosibErr<void> AffixMgr::build_pfxlist(PfxEntry* pfxptr)
 // both by suffix flag, and sorted by the reverse of the
 // suffix string itself; so we need to set up two indexes
 
-PosibErr<void> AffixMgr::build_sfxlist(SfxEntry* sfxptr)
+PosibErr<void> AffixMgr::build_sfxlist(AffixBuild & b, SfxEntry* sfxptr)
 {
   SfxEntry * ptr;
   SfxEntry * ep = sfxptr;
@@ -546,126 +637,278 @@ PosibErr<void> AffixMgr::build_sfxlist(SfxEntry* sfxptr)
   const byte flg = ep->flag();
 
   // first index by flag which must exist
-  ptr = sFlag[flg];
+  ptr = b.sFlag[flg];
   ep->flag_next = ptr;
-  sFlag[flg] = ep;
+  b.sFlag[flg] = ep;
 
   // next insert the affix string, it will be sorted latter
     
   byte sp = *((const byte *)key);
-  ptr = sStart[sp];
+  ptr = b.sStart[sp];
   ep->next = ptr;
-  sStart[sp] = ep;
+  b.sStart[sp] = ep;
   return no_err;
 }
 
 
 
-// initialize the PfxEntry links NextEQ and NextNE to speed searching
-PosibErr<void> AffixMgr::process_pfx_order()
-{
-  PfxEntry* ptr;
+// Now we can speed up performance greatly by putting the affix
+// strings in a trie, with the suffix strings reversed.  Then all the
+// affixes present in a word can be found in a single pass over the
+// word, starting at the beginning of the word for prefixes and at
+// the end for suffixes.
+//
+// Everything is then copied into a single block, see AffixImage.
 
-  // loop through each prefix list starting point
+void AffixMgr::compile(AffixBuild & b)
+{
+  Vector< AffixNode<PfxEntry> > ptrie(1); // 0 is used for none
+  Vector< AffixNode<SfxEntry> > strie(1);
+  unsigned pRoot[SETSIZE] = {0};
+  unsigned sRoot[SETSIZE] = {0};
   for (int i=1; i < SETSIZE; i++) {
+    if (b.pStart[i] && b.pStart[i]->next)
+      b.pStart[i] = sort(b.pStart[i], AffixLess<PfxEntry>(), AffixNext<PfxEntry>());
+    build_trie(b.pStart[i], ptrie, pRoot[i]);
+    if (b.sStart[i] && b.sStart[i]->next)
+      b.sStart[i] = sort(b.sStart[i], AffixLess<SfxEntry>(), AffixNext<SfxEntry>());
+    build_trie(b.sStart[i], strie, sRoot[i]);
+  }
 
-    ptr = pStart[i];
+  // collect what needs to be copied and figure out the layout
 
-    if (ptr && ptr->next)
-      ptr = pStart[i] = sort(ptr, AffixLess<PfxEntry>());
+  Vector<const PfxEntry *> pfx;
+  Vector<const SfxEntry *> sfx;
+  Vector<const Conds *>    conds;
+  size_t str_size = 0;
+  for (int i=0; i < SETSIZE; i++) {
+    for (const PfxEntry * p = b.pStart[i]; p; p = p->next) {
+      pfx.push_back(p);
+      conds.push_back(p->conds);
+      str_size += p->appndl + p->stripl + strlen(p->flags) + 3;
+    }
+    for (const SfxEntry * p = b.sStart[i]; p; p = p->next) {
+      sfx.push_back(p);
+      conds.push_back(p->conds);
+      str_size += 2*p->appndl + p->stripl + strlen(p->flags) + 4;
+    }
+  }
+  std::sort(conds.begin(), conds.end());
+  conds.erase(std::unique(conds.begin(), conds.end()), conds.end());
+
+  size_t pfx_o   = sizeof(AffixImage);
+  size_t sfx_o   = pfx_o   + pfx.size()   * sizeof(PfxEntry);
+  size_t conds_o = sfx_o   + sfx.size()   * sizeof(SfxEntry);
+  size_t ptrie_o = conds_o + conds.size() * sizeof(Conds);
+  size_t strie_o = ptrie_o + ptrie.size() * sizeof(AffixNode<PfxEntry>);
+  size_t str_o   = strie_o + strie.size() * sizeof(AffixNode<SfxEntry>);
+  image_buf.resize(str_o + str_size);
+  memset(image_buf.data(), 0, image_buf.size());
+  image_size = image_buf.size();
+
+  char * block = image_buf.data();
+  AffixImage * img = new (block) AffixImage;
+  char * str = block + str_o;
+
+  AddrMap<PfxEntry> pmap;
+  AddrMap<SfxEntry> smap;
+  AddrMap<const Conds> cmap;
+  for (unsigned i = 0; i != pfx.size(); ++i)
+    pmap.add(pfx[i], (PfxEntry *)(block + pfx_o) + i);
+  for (unsigned i = 0; i != sfx.size(); ++i)
+    smap.add(sfx[i], (SfxEntry *)(block + sfx_o) + i);
+  for (unsigned i = 0; i != conds.size(); ++i)
+    cmap.add(conds[i], (const Conds *)((Conds *)(block + conds_o) + i));
+  pmap.done();
+  smap.done();
+  cmap.done();
+
+  // now copy everything
+
+  for (unsigned i = 0; i != conds.size(); ++i) {
+    Conds * c = new (block + conds_o + i * sizeof(Conds)) Conds;
+    c->num = conds[i]->num;
+    memcpy(c->conds, conds[i]->conds, sizeof(c->conds));
+  }
 
-    // look through the remainder of the list
-    //  and find next entry with affix that 
-    // the current one is not a subset of
-    // mark that as destination for NextNE
-    // use next in list that you are a subset
-    // of as NextEQ
+#define COPY_STR(to, from) \
+  do {size_t n = strlen(from) + 1; memcpy(str, from, n); to = str; str += n;} while (false)
+
+  for (unsigned i = 0; i != pfx.size(); ++i) {
+    PfxEntry * p = new (pmap(pfx[i])) PfxEntry(*pfx[i]);
+    COPY_STR(p->appnd, pfx[i]->appnd);
+    COPY_STR(p->strip, pfx[i]->strip);
+    COPY_STR(p->flags, pfx[i]->flags);
+    p->conds = cmap(pfx[i]->conds);
+    p->next = pmap(pfx[i]->next);
+    p->flag_next = pmap(pfx[i]->flag_next);
+  }
+  for (unsigned i = 0; i != sfx.size(); ++i) {
+    SfxEntry * p = new (smap(sfx[i])) SfxEntry(*sfx[i]);
+    COPY_STR(p->appnd, sfx[i]->appnd);
+    COPY_STR(p->rappnd, sfx[i]->rappnd);
+    COPY_STR(p->strip, sfx[i]->strip);
+    COPY_STR(p->flags, sfx[i]->flags);
+    p->conds = cmap(sfx[i]->conds);
+    p->next = smap(sfx[i]->next);
+    p->flag_next = smap(sfx[i]->flag_next);
+  }
 
-    for (; ptr != NULL; ptr = ptr->next) {
+#undef COPY_STR
 
-      PfxEntry * nptr = ptr->next;
-      for (; nptr != NULL; nptr = nptr->next) {
-        if (! isSubset( ptr->key() , nptr->key() )) break;
-      }
-      ptr->next_ne = nptr;
-      ptr->next_eq = NULL;
-      if ((ptr->next) && isSubset(ptr->key() , 
-                                  (ptr->next)->key())) 
-        ptr->next_eq = ptr->next;
-    }
+  AffixNode<PfxEntry> * pn = (AffixNode<PfxEntry> *)(block + ptrie_o);
+  for (unsigned i = 0; i != ptrie.size(); ++i) {
+    new (pn + i) AffixNode<PfxEntry>(ptrie[i]);
+    pn[i].first = pmap(ptrie[i].first);
+  }
+  AffixNode<SfxEntry> * sn = (AffixNode<SfxEntry> *)(block + strie_o);
+  for (unsigned i = 0; i != strie.size(); ++i) {
+    new (sn + i) AffixNode<SfxEntry>(strie[i]);
+    sn[i].first = smap(strie[i].first);
+  }
 
-    // now clean up by adding smart search termination strings
-    // if you are already a superset of the previous prefix
-    // but not a subset of the next, search can end here
-    // so set NextNE properly
-
-    ptr = pStart[i];
-    for (; ptr != NULL; ptr = ptr->next) {
-      PfxEntry * nptr = ptr->next;
-      PfxEntry * mptr = NULL;
-      for (; nptr != NULL; nptr = nptr->next) {
-        if (! isSubset(ptr->key(),nptr->key())) break;
-        mptr = nptr;
-      }
-      if (mptr) mptr->next_ne = NULL;
-    }
+  img->pStart0 = pmap(b.pStart[0]);
+  img->sStart0 = smap(b.sStart[0]);
+  for (int i=0; i < SETSIZE; i++) {
+    img->pFlag[i] = pmap(b.pFlag[i]);
+    img->sFlag[i] = smap(b.sFlag[i]);
+    img->pRoot[i] = pRoot[i];
+    img->sRoot[i] = sRoot[i];
+    img->max_strip_f[i] = b.max_strip_f[i];
   }
-  return no_err;
-}
+  img->pTrie = pn;
+  img->sTrie = sn;
+  img->max_strip = b.max_strip;
+  img->two_fold_suffix = b.two_fold_suffix;
 
+  d = img;
+}
 
+#ifdef HAVE_MMAP
 
-// initialize the SfxEntry links NextEQ and NextNE to speed searching
-PosibErr<void> AffixMgr::process_sfx_order()
+static inline char * mmap_open(unsigned int block_size, 
+			       FStream & f, 
+			       unsigned int offset) 
 {
-  SfxEntry* ptr;
-
-  // loop through each prefix list starting point
-  for (int i=1; i < SETSIZE; i++) {
+  f.flush();
+  int fd = f.file_no();
+  char * p = static_cast<char *>
+    (mmap(NULL, block_size, PROT_READ, MAP_SHARED, fd, offset));
+  return p == (char *)MAP_FAILED ? 0 : p;
+}
 
-    ptr = sStart[i];
+#else
 
-    if (ptr && ptr->next)
-      ptr = sStart[i] = sort(ptr, AffixLess<SfxEntry>());
+static inline char * mmap_open(unsigned int, FStream &, unsigned int) 
+{
+  return 0;
+}
 
-    // look through the remainder of the list
-    //  and find next entry with affix that 
-    // the current one is not a subset of
-    // mark that as destination for NextNE
-    // use next in list that you are a subset
-    // of as NextEQ
+#endif
 
-    for (; ptr != NULL; ptr = ptr->next) {
-      SfxEntry * nptr = ptr->next;
-      for (; nptr != NULL; nptr = nptr->next) {
-        if (! isSubset(ptr->key(),nptr->key())) break;
-      }
-      ptr->next_ne = nptr;
-      ptr->next_eq = NULL;
-      if ((ptr->next) && isSubset(ptr->key(),(ptr->next)->key())) 
-        ptr->next_eq = ptr->next;
-    }
+bool AffixMgr::load_image(const char * file)
+{
+  FStream f;
+  PosibErrBase pe = f.open(file, "rb");
+  if (pe.has_err()) {pe.ignore_err(); return false;}
+
+  AffixImageHead head;
+  if (!f.read(&head, sizeof(AffixImageHead))
+      || strcmp(head.check_word, affix_image_check_word) != 0
+      || head.endian_check != 12345678
+      || head.ptr_size != sizeof(void *)
+      || head.aff_size != aff_size
+      || head.aff_hash != aff_hash
+      || strcmp(head.charmap, lang->charmap()) != 0
+      || strcmp(head.encoding, lang->data_encoding()) != 0
+      || head.image_size != sizeof(AffixImage)
+      || head.pfx_size != sizeof(PfxEntry)
+      || head.sfx_size != sizeof(SfxEntry)
+      || head.conds_size != sizeof(Conds)
+      || head.node_size != sizeof(AffixNode<PfxEntry>))
+    return false;
 
+  // a truncated image would fault when used, so only use an image of
+  // exactly the right size
+  if (head.head_size < sizeof(AffixImageHead)) return false;
+  struct stat st;
+  if (fstat(f.file_no(), &st) != 0 
+      || st.st_size != (off_t)head.head_size + (off_t)head.block_size)
+    return false;
 
-    // now clean up by adding smart search termination strings:
-    // if you are already a superset of the previous suffix
-    // but not a subset of the next, search can end here
-    // so set NextNE properly
+  char * block;
+  mmaped_image = mmap_open(head.head_size + head.block_size, f, 0);
+  if (mmaped_image) {
+    mmaped_size = head.head_size + head.block_size;
+    block = mmaped_image + head.head_size;
+  } else {
+    image_buf.resize(head.block_size);
+    f.seek(head.head_size);
+    if (!f.read(image_buf.data(), head.block_size)) return false;
+    block = image_buf.data();
+  }
+  image_size = head.block_size;
+  d = reinterpret_cast<const AffixImage *>(block);
+  return true;
+}
 
-    ptr = sStart[i];
-    for (; ptr != NULL; ptr = ptr->next) {
-      SfxEntry * nptr = ptr->next;
-      SfxEntry * mptr = NULL;
-      for (; nptr != NULL; nptr = nptr->next) {
-        if (! isSubset(ptr->key(),nptr->key())) break;
-        mptr = nptr;
-      }
-      if (mptr) mptr->next_ne = NULL;
-    }
+PosibErr<void> AffixMgr::write_image(ParmString file) const
+{
+  AffixImageHead head;
+  memset(&head, 0, sizeof(AffixImageHead));
+  strncpy(head.check_word, affix_image_check_word, sizeof(head.check_word) - 1);
+  head.endian_check = 12345678;
+  head.ptr_size = sizeof(void *);
+  head.aff_size = aff_size;
+  head.aff_hash = aff_hash;
+  strncpy(head.charmap, lang->charmap(), sizeof(head.charmap) - 1);
+  strncpy(head.encoding, lang->data_encoding(), sizeof(head.encoding) - 1);
+  head.head_size = 64 * ((sizeof(AffixImageHead) + 63) / 64);
+  head.block_size = image_size;
+  head.image_size = sizeof(AffixImage);
+  head.pfx_size = sizeof(PfxEntry);
+  head.sfx_size = sizeof(SfxEntry);
+  head.conds_size = sizeof(Conds);
+  head.node_size = sizeof(AffixNode<PfxEntry>);
+
+  // The image may be mmaped, possibly by this very object, so write
+  // a new file and rename it rather than overwriting the old one in
+  // place.
+  // If the directory can not be written to, as is common for the
+  // system data directory, nothing is created and the error is
+  // returned for the caller to ignore.  On any other error the
+  // partial file is removed so that it never replaces a good image.
+  String tmp = file;
+  tmp += ".new";
+  FILE * fp = fopen(tmp.str(), "wb");
+  if (!fp) return make_err(cant_write_file, tmp);
+  bool ok;
+  {
+    FStream out(fp, false);
+    out.write(&head, sizeof(AffixImageHead));
+    for (unsigned i = sizeof(AffixImageHead); i != head.head_size; ++i)
+      out << '\0';
+    out.write(d, image_size);
+    out.flush();
+    ok = out;
+  }
+  if (fclose(fp) != 0) ok = false;
+  if (!ok || !rename_file(tmp, file)) {
+    remove_file(tmp);
+    return make_err(cant_write_file, file);
   }
   return no_err;
 }
 
+String affix_image_file(ParmString affpath)
+{
+  String file = affpath;
+  if (file.suffix(".dat"))
+    file.resize(file.size() - 4);
+  file += ".img";
+  return file;
+}
+
 // takes aff file condition string and creates the
 // conds array - please see the appendix at the end of the
 // file affentry.cxx which describes what is going on here
@@ -792,23 +1035,27 @@ bool AffixMgr::prefix_check (const LookupInfo & linf, ParmString word,
 {
  
   // first handle the special case of 0 length prefixes
-  PfxEntry * pe = pStart[0];
+  PfxEntry * pe = d->pStart0;
   while (pe) {
     if (pe->check(linf,this,word,ci,gi)) return true;
     pe = pe->next;
   }
   
-  // now handle the general case
-  byte sp = *reinterpret_cast<const byte *>(word.str());
-  PfxEntry * pptr = pStart[sp];
-
-  while (pptr) {
-    if (isSubset(pptr->key(),word)) {
+  // now handle the general case by walking down the trie, checking
+  // the entries of each node, which will be in order of length
+  const byte * c = reinterpret_cast<const byte *>(word.str());
+  const byte * end = c + word.size();
+  if (c == end) return false;
+  const AffixNode<PfxEntry> * trie = d->pTrie;
+  unsigned n = d->pRoot[*c];
+
+  while (n) {
+    const AffixNode<PfxEntry> & node = trie[n];
+    PfxEntry * pptr = node.first;
+    for (unsigned i = 0; i != node.num; ++i, pptr = pptr->next)
       if (pptr->check(linf,this,word,ci,gi,cross)) return true;
-      pptr = pptr->next_eq;
-    } else {
-      pptr = pptr->next_ne;
-    }
+    if (++c == end) break;
+    for (n = node.child; n && trie[n].ch != *c; n = trie[n].sibling);
   }
     
   return false;
@@ -822,23 +1069,28 @@ bool AffixMgr::suffix_check (const LookupInfo & linf, ParmString word,
 {
 
   // first handle the special case of 0 length suffixes
-  SfxEntry * se = sStart[0];
+  SfxEntry * se = d->sStart0;
   while (se) {
     if (se->check(linf, this, word, ci, gi, ppfx, psfx)) return true;
     se = se->next;
   }
   
-  // now handle the general case
-  byte sp = *((const byte *)(word + word.size() - 1));
-  SfxEntry * sptr = sStart[sp];
-
-  while (sptr) {
-    if (isRevSubset(sptr->key(), word + word.size() - 1, word.size())) {
+  // now handle the general case by walking down the trie from the
+  // end of the word
+  const byte * begin = reinterpret_cast<const byte *>(word.str());
+  const byte * c = begin + word.size();
+  if (c == begin) return false;
+  const AffixNode<SfxEntry> * trie = d->sTrie;
+  unsigned n = d->sRoot[*--c];
+
+  while (n) {
+    const AffixNode<SfxEntry> & node = trie[n];
+    SfxEntry * sptr = node.first;
+    for (unsigned i = 0; i != node.num; ++i, sptr = sptr->next)
       if (sptr->check(linf, this, word, ci, gi, ppfx, psfx)) return true;
-      sptr = sptr->next_eq;
-    } else {
-      sptr = sptr->next_ne;
-    }
+    if (c == begin) break;
+    --c;
+    for (n = node.child; n && trie[n].ch != *c; n = trie[n].sibling);
   }
     
   return false;
@@ -916,10 +1168,10 @@ WordAff * AffixMgr::expand(ParmString word, ParmString aff,
        c != end; 
        ++c) 
   {
-    if (sFlag[*c]) *suf_e++ = *c; 
-    if (sFlag[*c] && sFlag[*c]->allow_cross()) *csuf_e++ = *c;
+    if (d->sFlag[*c]) *suf_e++ = *c; 
+    if (d->sFlag[*c] && d->sFlag[*c]->allow_cross()) *csuf_e++ = *c;
     
-    for (PfxEntry * p = pFlag[*c]; p; p = p->flag_next) {
+    for (PfxEntry * p = d->pFlag[*c]; p; p = p->flag_next) {
       SimpleString newword = p->add(word, buf);
       if (!newword) continue;
       cur->next = (WordAff *)buf.alloc_bottom(sizeof(WordAff));
@@ -960,8 +1212,8 @@ WordAff * AffixMgr::expand_suffix(ParmString word, const byte * aff,
   if (!orig_word) orig_word = word;
 
   while (*aff) {
-    if ((int)word.size() - max_strip_f[*aff] < limit) {
-      for (SfxEntry * p = sFlag[*aff]; p; p = p->flag_next) {
+    if ((int)word.size() - d->max_strip_f[*aff] < limit) {
+      for (SfxEntry * p = d->sFlag[*aff]; p; p = p->flag_next) {
         SimpleString newword = p->add(word, buf, limit, orig_word);
         if (!newword) continue;
         if (newword == EMPTY) {not_expanded = true; continue;}
@@ -974,7 +1226,7 @@ WordAff * AffixMgr::expand_suffix(ParmString word, const byte * aff,
         // FIXME: I am making some, possible invalid, assumtions
         //        when limit is used
         if (twofold && p->flags[0]) {
-          expand_suffix(newword, (const byte *)p->flags, buf, INT_MAX, 0, &cur, orig_word, false);
+          expand_suffix(newword, (const byte *)p->flags.get(), buf, INT_MAX, 0, &cur, orig_word, false);
         }
       }
     } 
@@ -990,11 +1242,11 @@ WordAff * AffixMgr::expand_suffix(ParmString word, const byte * aff,
 CheckAffixRes AffixMgr::check_affix(ParmString word, char aff) const
 {
   CheckAffixRes res = InvalidAffix;
-  for (PfxEntry * p = pFlag[(unsigned char)aff]; p; p = p->flag_next) {
+  for (PfxEntry * p = d->pFlag[(unsigned char)aff]; p; p = p->flag_next) {
     res = InapplicableAffix;
     if (p->applicable(word)) return ValidAffix;
   }
-  for (SfxEntry * p = sFlag[(unsigned char)aff]; p; p = p->flag_next) {
+  for (SfxEntry * p = d->sFlag[(unsigned char)aff]; p; p = p->flag_next) {
     if (res == InvalidAffix) res = InapplicableAffix;
     if (p->applicable(word)) return ValidAffix;
   }
@@ -11,6 +11,8 @@
 #ifndef ASPELL_AFFIX__HPP
 #define ASPELL_AFFIX__HPP
 
+#include <stddef.h>
+
 #include "posib_err.hpp"
 #include "wordinfo.hpp"
 #include "fstream.hpp"
@@ -18,6 +20,7 @@
 #include "simple_string.hpp"
 #include "char_vector.hpp"
 #include "objstack.hpp"
+#include "string.hpp"
 
 #define SETSIZE         256
 #define MAXAFFIXES      256
@@ -48,18 +51,59 @@ namespace sp {
   struct PfxEntry;
   struct SfxEntry;
 
+  struct AffixImage;
+  struct AffixBuild;
+
   enum CheckAffixRes {InvalidAffix, InapplicableAffix, ValidAffix};
 
+  // A pointer stored as the offset from its own address.  The
+  // compiled affix data only uses these so that it can be mmaped at
+  // any address and used as is.
+  template <class T>
+  class RelPtr {
+    ptrdiff_t off_;
+  public:
+    RelPtr() : off_(0) {}
+    RelPtr(T * p) {*this = p;}
+    RelPtr(const RelPtr & other) {*this = other.get();}
+    RelPtr & operator= (const RelPtr & other) {return *this = other.get();}
+    RelPtr & operator= (T * p) {
+      off_ = p ? (const char *)p - (const char *)this : 0;
+      return *this;
+    }
+    T * get() const {return off_ ? (T *)((const char *)this + off_) : 0;}
+    operator T * () const {return get();}
+    T * operator-> () const {return get();}
+  };
+
+  // A node in the trie of affix strings (reversed for suffixes).
+  // The nodes are stored in an array, 0 is used for none.
+  template <class Entry>
+  struct AffixNode {
+    unsigned char ch;
+    unsigned      child;   // the first child
+    unsigned      sibling; // the next child of the parent
+    RelPtr<Entry> first;   // the entries whose affix string ends here,
+    unsigned      num;     // they follow each other in the "next" list
+  };
+
   class AffixMgr
   {
     const LangImpl * lang;
 
-    PfxEntry *          pStart[SETSIZE];
-    SfxEntry *          sStart[SETSIZE];
-    PfxEntry *          pFlag[SETSIZE];
-    SfxEntry *          sFlag[SETSIZE];
+    // The affix data is compiled into a single block which is either
+    // in image_buf or mmaped from a previously written image.
+    const AffixImage *  d;
+    CharVector          image_buf;
+    char *              mmaped_image;
+    unsigned int        mmaped_size;
+    unsigned int        image_size;
+
+    // the size and a hash of the affix file, used to tell if an
+    // image is still current
+    unsigned int        aff_size;
+    unsigned int        aff_hash;
 
-    int max_strip_f[SETSIZE];
     int max_strip_;
 
     const char *        encoding;
@@ -82,6 +126,10 @@ namespace sp {
 
     PosibErr<void> setup(ParmString affpath, Conv &);
 
+    // writes the compiled affix data so that later setups with the
+    // same affix file can use it without parsing the affix file
+    PosibErr<void> write_image(ParmString file) const;
+
     bool affix_check(const LookupInfo &, ParmString, IntrCheckInfo &, GuessInfo *) const;
     bool prefix_check(const LookupInfo &, ParmString, IntrCheckInfo &, GuessInfo *,
                       bool cross = true) const;
@@ -108,14 +156,19 @@ namespace sp {
                             ParmString orig_word = 0, bool twofold = true) const;
     
   private:
-    PosibErr<void> parse_file(const char * affpath, Conv &);
+    PosibErr<void> parse_file(const char * affpath, Conv &, AffixBuild &);
+
+    PosibErr<void> build_pfxlist(AffixBuild &, PfxEntry* pfxptr);
+    PosibErr<void> build_sfxlist(AffixBuild &, SfxEntry* sfxptr);
+    void compile(AffixBuild &);
 
-    PosibErr<void> build_pfxlist(PfxEntry* pfxptr);
-    PosibErr<void> build_sfxlist(SfxEntry* sfxptr);
-    PosibErr<void> process_pfx_order();
-    PosibErr<void> process_sfx_order();
+    bool load_image(const char * file);
   };
 
+  // returns the file the compiled affix data for the affix file
+  // affpath is written to
+  String affix_image_file(ParmString affpath);
+
   PosibErr<AffixMgr *> new_affix_mgr(ParmString name, 
                                      Conv &,
                                      const LangImpl * lang);
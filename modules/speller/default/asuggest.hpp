@@ -43,6 +43,8 @@ namespace aspell { namespace sp {
 
     aspell::String split_chars;
 
+    int threads; // number of threads to generate candidates with
+
     SuggestParms() {}
     
     aspell::PosibErr<void> set(ParmString mode, SpellerImpl * sp);
@@ -0,0 +1,80 @@
+// This file is part of The New Aspell
+// Copyright (C) 2026 under the GNU LGPL license version 2.0 or 2.1.
+// You should have received a copy of the LGPL license along with this
+// library if you did not you can find it at http://www.gnu.org/.
+
+#ifndef __aspeller_bp_edit_distance_hh__
+#define __aspeller_bp_edit_distance_hh__
+
+#include <string.h>
+
+#include "parm_string.hpp"
+#include "weights.hpp"
+
+namespace aspell { namespace sp {
+
+  // BitParallelEditDist counts the fewest edits needed to turn a fixed
+  // word, the pattern, into other words, where an edit is a deletion,
+  // an insertion, a substitution or a swap of two adjacent letters,
+  // and no letter is edited more than once (the "optimal string
+  // alignment" distance).  It uses Hyyro's extension of Myers's
+  // bit-vector algorithm, so each letter of the other word costs a
+  // handful of word operations instead of a row of a dynamic
+  // programming matrix.
+  //
+  // The pattern may be at most 64 characters long.  For longer
+  // patterns, count always returns 0.
+  //
+  // Every edit path that the weighted edit distance functions (see
+  // editdist.hpp, leditdist.hpp) consider is made up of at least
+  // count(b) edits, thus count(b)*w.min is a lower bound on their
+  // result, see min_score.
+
+  class BitParallelEditDist {
+  public:
+    typedef unsigned long long Bits;
+    static const unsigned max_size = 64;
+  private:
+    Bits     peq_[256]; // the positions of each character in the pattern
+    unsigned size_;     // 0 if the pattern is too long
+  public:
+    BitParallelEditDist() : size_(0) {}
+    BitParallelEditDist(ParmString a) {set(a);}
+    void set(ParmString a) {
+      memset(peq_, 0, sizeof(peq_));
+      size_ = a.size() <= max_size ? a.size() : 0;
+      for (unsigned i = 0; i != size_; ++i)
+        peq_[(unsigned char)a[i]] |= (Bits)1 << i;
+    }
+    bool usable() const {return size_ != 0;}
+
+    unsigned count(const char * b) const {
+      if (size_ == 0) return 0;
+      const Bits last = (Bits)1 << (size_ - 1);
+      Bits vp = ~(Bits)0, vn = 0, d0 = 0, pm_prev = 0;
+      unsigned score = size_;
+      for (; *b; ++b) {
+        Bits pm = peq_[(unsigned char)*b];
+        Bits tr = (((~d0) & pm) << 1) & pm_prev;
+        d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+        Bits hp = vn | ~(d0 | vp);
+        Bits hn = d0 & vp;
+        if (hp & last)      ++score;
+        else if (hn & last) --score;
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        pm_prev = pm;
+      }
+      return score;
+    }
+
+    int min_score(const char * b, const EditDistanceWeights & w) const {
+      return count(b) * w.min;
+    }
+  };
+
+} }
+
+#endif
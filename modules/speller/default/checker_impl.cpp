@@ -1,13 +1,14 @@
 #include "speller_impl.hpp"
 #include "lang_impl.hpp"
 #include "checker.hpp"
+#include "stack_ptr.hpp"
 
 namespace aspell { namespace sp {
 
   class CheckerImpl : public Checker 
   {
   public:
-    CheckerImpl(SpellerImpl *);
+    CheckerImpl(SpellerImpl *, CheckContext * = 0);
     void i_reset(Segment * seg);
     void i_recheck(Segment * seg);
     const CheckerToken * next();
@@ -17,6 +18,7 @@ namespace aspell { namespace sp {
     SegmentIterator cur_;
     SegmentIterator next_;
     SpellerImpl * speller;
+    StackPtr<CheckContext> ctx; // if set words are checked using it
     const LangImpl * lang;
     
     inline bool is_word(FilterChar::Chr c) {return lang->is_alpha(c);}
@@ -25,9 +27,10 @@ namespace aspell { namespace sp {
     inline bool is_end(FilterChar::Chr c) {return lang->special(c).end;}
   };
 
-  CheckerImpl::CheckerImpl(SpellerImpl * sp)
+  CheckerImpl::CheckerImpl(SpellerImpl * sp, CheckContext * c)
+    : ctx(c)
   {
-    init(sp);
+    init(sp, c);
     speller = sp;
     lang = &speller->lang();
   }
@@ -108,7 +111,10 @@ namespace aspell { namespace sp {
     token.e.seg = cur_.seg;
     token.e.pos = cur_.pos;
 
-    token.correct = speller->check(word);
+    if (ctx)
+      token.correct = ctx->check(MutableString(word.mstr(), word.size()));
+    else
+      token.correct = speller->check(word);
 
     free_segments(0, prev_.seg);
 
@@ -121,4 +127,8 @@ namespace aspell { namespace sp {
     return new CheckerImpl(this);
   }
 
+  Checker * SpellerImpl::new_checker(CheckContext * ctx) {
+    return new CheckerImpl(this, ctx);
+  }
+
 } }
@@ -238,6 +238,8 @@ namespace aspell { namespace sp {
     return make_err(unimplemented_method, "clear", class_name);
   }
 
+  void Dictionary::warm() {}
+
   StringEnumeration * Dictionary::elements() const
   {
     Enum * e = detailed_elements();
@@ -267,6 +269,15 @@ namespace aspell { namespace sp {
     return false;
   }
   
+  void Dictionary::batch_lookup(const ParmString * words, unsigned num,
+                                const SensitiveCompare * c,
+                                unsigned char * found) const
+  {
+    WordEntry w;
+    for (unsigned i = 0; i != num; ++i)
+      if (!found[i] && lookup(words[i], c, w)) found[i] = 1;
+  }
+
   bool Dictionary::clean_lookup(ParmString, WordEntry &) const 
   {
     return false;
@@ -422,8 +433,12 @@ namespace aspell { namespace sp {
     Lock dict_cache_lock(NULL);
 
     if (actual_type == DT_ReadOnly) { // try to get it from the cache
-      dict_cache_lock.set(&dict_cache.lock); 
-      res = dict_cache.find(id);
+      res = dict_cache.find_copy(id);
+      if (!res) {
+        dict_cache_lock.set(&dict_cache.lock); 
+        res = dict_cache.find(id);
+        if (res) res->copy_no_lock();
+      }
     }
 
     if (!res) {
@@ -453,11 +468,6 @@ namespace aspell { namespace sp {
       
       res = w.release();
 
-    } else { // actual_type == DT_ReadOnly implied, and hence the lock
-             // is already acquired
-
-      res->copy_no_lock();
-      
     }
 
     dict_cache_lock.release();
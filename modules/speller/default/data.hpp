@@ -106,6 +106,10 @@ namespace aspell { namespace sp {
     virtual PosibErr<void> save_as(ParmString);
     virtual PosibErr<void> clear();
 
+    // Starts bringing the parts of the dictionary used by lookups
+    // into memory in the background.  Does nothing by default.
+    virtual void warm();
+
     bool affix_compressed;
     bool invisible_soundslike; // true when words are grouped by the
                                // soundslike but soundslike data is not
@@ -131,6 +135,12 @@ namespace aspell { namespace sp {
   
     virtual bool lookup (ParmString word, const SensitiveCompare *, 
                          WordEntry &) const;
+
+    // Looks up num words at once.  For each word not already marked
+    // as found, found[i] is set to 1 if lookup would return true.
+    virtual void batch_lookup(const ParmString * words, unsigned num,
+                              const SensitiveCompare *, 
+                              unsigned char * found) const;
     
     virtual bool clean_lookup(ParmString, WordEntry &) const;
 
@@ -25,4 +25,18 @@ namespace aspell { namespace sp {
     } while (score >= LARGE_NUM && level <= limit);
     return score;
   }
+
+  // Same as above but given a lower bound on the number of edits
+  // needed (see BitParallelEditDist) levels that can not possibly
+  // succeed are skipped.
+  inline int edit_distance(ParmString a, ParmString b, 
+			   int level, int limit, int min_edits,
+			   const EditDistanceWeights & w) 
+  {
+    while (level < 5 && min_edits*w.min > level*w.max) {
+      if (level == limit) return LARGE_NUM;
+      ++level;
+    }
+    return edit_distance(a, b, level, limit, w);
+  }
 } }
@@ -65,12 +65,14 @@ namespace aspell { namespace sp {
 
   struct PhonetParmsImpl : public PhonetParms {
     void * data;
+    PhonetRule * info;
     ObjStack strings;
-    PhonetParmsImpl() : data(0) {}
-    ~PhonetParmsImpl() {if (data) free(data);}
+    PhonetParmsImpl() : data(0), info(0) {}
+    ~PhonetParmsImpl() {if (data) free(data); if (info) free(info);}
   };
 
   static void init_phonet_hash(PhonetParms & parms);
+  static void compile_phonet_rule(PhonetRule & r, const char * rule);
 
   // like strcpy but safe if the strings overlap
   //   but only if dest < src
@@ -91,8 +93,6 @@ namespace aspell { namespace sp {
 
     PhonetParmsImpl * parms = new PhonetParmsImpl();
 
-    parms->lang = lang;
-
     parms->followup        = true;
     parms->collapse_result = false;
     parms->remove_accents  = true;
@@ -142,6 +142,10 @@ namespace aspell { namespace sp {
     *(r+1) = PhonetParms::rules_end;
     parms->rules = (const char * *)parms->data;
 
+    parms->info = (PhonetRule *)malloc(sizeof(PhonetRule) * (num + 1));
+    for (int i = 0; parms->rules[2*i] != PhonetParms::rules_end; ++i)
+      compile_phonet_rule(parms->info[i], parms->rules[2*i]);
+    parms->rule_info = parms->info;
 
     for (unsigned i = 0; i != 256; ++i) {
       parms->to_clean[i] = (lang->char_type(i) > LangImpl::NonLetter 
@@ -149,6 +153,7 @@ namespace aspell { namespace sp {
                                ? lang->to_upper(lang->de_accent(i)) 
                                : lang->to_upper(i))
                             : 0);
+      parms->is_alpha[i] = lang->is_alpha(i);
     }
 
     init_phonet_hash(*parms);
@@ -156,6 +161,52 @@ namespace aspell { namespace sp {
     return parms;
   }
 
+  static GlobalCache<PhonetParms> phonet_parms_cache("phonet");
+
+  PosibErr<void> setup(CachePtr<const PhonetParms> & res,
+                       ParmString file, Conv & iconv, const LangImpl * lang)
+  {
+    RET_ON_ERR_SET(get_cache_data(&phonet_parms_cache, &iconv, lang, file),
+                   PhonetParms *, parms);
+    res.reset(parms);
+    return no_err;
+  }
+
+  PosibErr<PhonetParms *> 
+  PhonetParms::get_new(const char * file, const Conv * iconv, const LangImpl * lang)
+  {
+    // the converter is only const because get_cache_data says so, the
+    // caller still owns it and is not using it while we are
+    RET_ON_ERR_SET(new_phonet(file, const_cast<Conv &>(*iconv), lang),
+                   PhonetParms *, parms);
+    parms->file = file;
+    return parms;
+  }
+
+  static void compile_phonet_rule(PhonetRule & r, const char * rule)
+  {
+    r.search = *rule ? rule + 1 : rule;
+    const char * s = r.search;
+    while (*s != '\0' && !asc_isdigit(*s) && strchr("(-<^$", *s) == NULL)
+      ++s;
+    r.letters = s - r.search;
+    memset(r.in_paren, 0, sizeof(r.in_paren));
+    if (*s == '(') {
+      r.paren = s;
+      for (const char * p = s + 1; *p; ++p)
+        r.in_paren[(unsigned char)*p/8] |= 1 << ((unsigned char)*p%8);
+      while (*s != ')'  &&  *s != '\0')
+        s++;
+      if (*s == ')')
+        s++;
+      r.after_paren = s;
+    } else {
+      r.paren = r.after_paren = 0;
+    }
+    r.less = strchr(r.search, '<') != NULL;
+    r.start_again = strstr(r.search, "^^") != NULL;
+  }
+
   static void init_phonet_hash(PhonetParms & parms) 
   {
     int i, k;
@@ -204,6 +255,7 @@ namespace aspell { namespace sp {
     const char * s;
 
     typedef unsigned char uchar;
+    const bool * is_alpha = parms.is_alpha;
     
     /**  to convert string to uppercase and possible remove accents **/
     char * res = word;
@@ -232,24 +284,27 @@ namespace aspell { namespace sp {
           #endif
 
           /**  check whole string  **/
+          const PhonetRule & r = parms.rule_info[n/2];
           k = 1;   /** number of found letters  **/
           p = 5;   /** default priority  **/
-          s = parms.rules[n];
-          s++;     /**  important for (see below)  "*(s-1)"  **/
+          s = r.search;
           
-          while (*s != '\0'  &&  word[i+k] == *s
-                 &&  !asc_isdigit (*s)  &&  strchr ("(-<^$", *s) == NULL) {
+          while (k <= r.letters  &&  word[i+k] == *s) {
             k++;
             s++;
           }
-          if (*s == '(') {
+          if (k <= r.letters) {
+            /**  a plain letter does not match  **/
+            p0 = (int) *s;
+            n += 2;
+            continue;
+          }
+          if (r.paren) {
             /**  check letters in "(..)"  **/
-            if (parms.lang->is_alpha(word[i+k])  // ...could be implied?
-                && strchr(s+1, word[i+k]) != NULL) {
+            if (is_alpha[(uchar)word[i+k]]  // ...could be implied?
+                && r.paren_has(word[i+k])) {
               k++;
-              while (*s != ')')
-                s++;
-              s++;
+              s = r.after_paren;
             }
           }
           p0 = (int) *s;
@@ -270,12 +325,12 @@ namespace aspell { namespace sp {
 
           if (*s == '\0'
               || (*s == '^'  
-                  && (i == 0  ||  ! parms.lang->is_alpha(word[i-1]))
+                  && (i == 0  ||  ! is_alpha[(uchar)word[i-1]])
                   && (*(s+1) != '$'
-                      || (! parms.lang->is_alpha(word[i+k0]) )))
+                      || (! is_alpha[(uchar)word[i+k0]] )))
               || (*s == '$'  &&  i > 0  
-                  &&  parms.lang->is_alpha(word[i-1])
-                  && (! parms.lang->is_alpha(word[i+k0]) ))) 
+                  &&  is_alpha[(uchar)word[i-1]]
+                  && (! is_alpha[(uchar)word[i+k0]] ))) 
           {
             /**  search for followup rules, if:     **/
             /**  parms.followup and k > 1  and  NO '-' in searchstring **/
@@ -291,24 +346,27 @@ namespace aspell { namespace sp {
                 #endif
 
                 /**  check whole string  **/
+                const PhonetRule & r0 = parms.rule_info[n0/2];
                 k0 = k;
                 p0 = 5;
-                s = parms.rules[n0];
-                s++;
-                while (*s != '\0'  &&  word[i+k0] == *s
-                       && ! asc_isdigit(*s)  &&  strchr("(-<^$",*s) == NULL) {
+                s = r0.search;
+                while (k0 - k < r0.letters  &&  word[i+k0] == *s) {
                   k0++;
                   s++;
                 }
-                if (*s == '(') {
+                if (k0 - k < r0.letters) {
+                  #ifdef PHONET_TRACE
+                      cout << "discarded";
+                  #endif
+                  n0 += 2;
+                  continue;
+                }
+                if (r0.paren) {
                   /**  check letters  **/
-                  if (parms.lang->is_alpha(word[i+k0])
-                      &&  strchr (s+1, word[i+k0]) != NULL) {
+                  if (is_alpha[(uchar)word[i+k0]]
+                      &&  r0.paren_has(word[i+k0])) {
                     k0++;
-                    while (*s != ')'  &&  *s != '\0')
-                      s++;
-                    if (*s == ')')
-                      s++;
+                    s = r0.after_paren;
                   }
                 }
                 while (*s == '-') {
@@ -325,7 +383,7 @@ namespace aspell { namespace sp {
 
                 if (*s == '\0'
                     /**  *s == '^' cuts  **/
-                    || (*s == '$'  &&  ! parms.lang->is_alpha(word[i+k0]))) 
+                    || (*s == '$'  &&  ! is_alpha[(uchar)word[i+k0]])) 
                 {
                   if (k0 == k) {
                     /**  this is just a piece of the string  **/
@@ -369,8 +427,7 @@ namespace aspell { namespace sp {
                 trace_info ("\nUsing rule No.", n,"\n",parms);
             #endif
             s = parms.rules[n+1];
-            p0 = (parms.rules[n][0] != '\0'
-                 &&  strchr (parms.rules[n]+1,'<') != NULL) ? 1:0;
+            p0 = r.less ? 1:0;
             if (p0 == 1 &&  z == 0) {
               /**  rule with '<' is used  **/
               if (j > 0  &&  *s != '\0'
@@ -404,8 +461,7 @@ namespace aspell { namespace sp {
               }
               /**  new "actual letter"  **/
               c = *s;
-              if (parms.rules[n][0] != '\0'
-                 &&  strstr (parms.rules[n]+1, "^^") != NULL) {
+              if (r.start_again) {
                 if (c != '\0') {
                   target[j] = c;
                   j++;
@@ -20,6 +20,7 @@
 #ifndef ASPELLER_PHONET__HPP
 #define ASPELLER_PHONET__HPP
 
+#include "cache.hpp"
 #include "string.hpp"
 #include "posib_err.hpp"
 
@@ -30,7 +31,21 @@ namespace aspell { namespace sp {
 
   class LangImpl;
 
-  struct PhonetParms {
+  // What phonet needs to know about a rule's search string that does
+  // not depend on the word, worked out once when the rules are loaded.
+  struct PhonetRule {
+    const char * search;  // the search string after the first letter
+    int letters;          // number of plain letters at the start of search
+    const char * paren;   // points to the '(' after them, or null
+    const char * after_paren; // just past the matching ')'
+    unsigned char in_paren[256/8]; // letters after the '(', as a bit set
+    bool less;            // search contains a '<'
+    bool start_again;     // search contains "^^"
+    bool paren_has(char c) const {
+      unsigned char u = c; return in_paren[u/8] & (1 << (u%8));}
+  };
+
+  struct PhonetParms : public Cacheable {
     String version;
     
     bool followup;
@@ -40,14 +55,21 @@ namespace aspell { namespace sp {
 
     static const char * const rules_end;
     const char * * rules;
-
-    const LangImpl * lang;
+    const PhonetRule * rule_info; // rule_info[n/2] is for rules[n]
 
     char to_clean[256];
+    bool is_alpha[256];
 
     static const int hash_size = 256;
     int hash[hash_size];
 
+    String file;
+    typedef Conv CacheConfig;
+    typedef const LangImpl CacheConfig2;
+    typedef const char * CacheKey;
+    bool cache_key_eq(const char * f) const {return file == f;}
+    static PosibErr<PhonetParms *> get_new(const char *, const Conv *, const LangImpl *);
+
     virtual ~PhonetParms() {}
   };
 
@@ -64,6 +86,12 @@ namespace aspell { namespace sp {
                                      Conv & iconv,
                                      const LangImpl * lang);
 
+  // Gets the rules in "file" from a cache shared by all languages
+  // using them.  The rules are never modified once loaded so a single
+  // copy may be used by any number of threads.
+  PosibErr<void> setup(CachePtr<const PhonetParms> & res,
+                       ParmString file, Conv & iconv, const LangImpl * lang);
+
 } }
 
 #endif
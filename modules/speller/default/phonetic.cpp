@@ -124,7 +124,7 @@ namespace aspell { namespace sp {
   class PhonetSoundslike : public Soundslike {
 
     const LangImpl * lang;
-    StackPtr<PhonetParms> phonet_parms;
+    CachePtr<const PhonetParms> phonet_parms;
     
   public:
 
@@ -136,10 +136,7 @@ namespace aspell { namespace sp {
       file += '/';
       file += lang->name();
       file += "_phonet.dat";
-      PosibErr<PhonetParms *> pe = new_phonet(file, iconv, lang);
-      if (pe.has_err()) return pe;
-      phonet_parms.reset(pe);
-      return no_err;
+      return sp::setup(phonet_parms, file, iconv, lang);
     }
 
 
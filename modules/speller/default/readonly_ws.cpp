@@ -11,6 +11,7 @@
 // * jump table for editdist 2
 // * data block
 // * hash table
+// * bloom filter (optional)
 
 // data block laid out as follows:
 //
@@ -33,6 +34,8 @@ using std::pair;
 
 #include <string.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 //#include <errno.h>
 
 #include "settings.h"
@@ -46,6 +49,8 @@ using std::pair;
 #include "errors.hpp"
 #include "lang_impl.hpp"
 #include "stack_ptr.hpp"
+#include "lock.hpp"
+#include "thread.hpp"
 #include "objstack.hpp"
 #include "vector.hpp"
 #include "vector_hash-t.hpp"
@@ -86,12 +91,42 @@ using namespace aspell;
 
 static inline char * mmap_open(unsigned int block_size, 
 			       FStream & f, 
-			       unsigned int offset) 
+			       unsigned int offset,
+                               bool prefault) 
 {
   f.flush();
   int fd = f.file_no();
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (prefault) flags |= MAP_POPULATE;
+#endif
   return static_cast<char *>
-    (mmap(NULL, block_size, PROT_READ, MAP_SHARED, fd, offset));
+    (mmap(NULL, block_size, PROT_READ, flags, fd, offset));
+}
+
+// None of these are required to succeed, if one fails the pages
+// are simply read in when first used as they would be otherwise.
+static void mmap_advise(char * block, unsigned int size,
+                        bool prefault, bool huge_pages, bool lock)
+{
+#ifdef MADV_WILLNEED
+  if (prefault) madvise(block, size, MADV_WILLNEED);
+#endif
+#ifdef MADV_HUGEPAGE
+  if (huge_pages) madvise(block, size, MADV_HUGEPAGE);
+#endif
+  if (lock) mlock(block, size);
+}
+
+// Asks for the pages of [begin, end) to be read in ahead of use.
+static void mmap_will_need(const char * begin, const char * end)
+{
+#ifdef MADV_WILLNEED
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (page_size <= 0 || begin >= end) return;
+  char * b = (char *)((size_t)begin & ~(size_t)(page_size - 1));
+  madvise(b, end - b, MADV_WILLNEED);
+#endif
 }
 
 static inline void mmap_free(char * block, unsigned int size) 
@@ -103,11 +138,16 @@ static inline void mmap_free(char * block, unsigned int size)
 
 static inline char * mmap_open(unsigned int, 
 			       FStream & f, 
-			       unsigned int) 
+			       unsigned int,
+                               bool) 
 {
   return reinterpret_cast<char *>(MAP_FAILED);
 }
 
+static inline void mmap_advise(char *, unsigned int, bool, bool, bool) {}
+
+static inline void mmap_will_need(const char *, const char *) {}
+
 static inline void mmap_free(char *, unsigned int) 
 {
   abort();
@@ -180,6 +220,67 @@ static inline bool duplicate_flag(const char * d) {
   return get_flags(d) & DUPLICATE_FLAG;
 }
 
+//
+// The optional Bloom filter in front of the word lookup table.  It is
+// a blocked filter, all the bits for a word are in the same 64 byte
+// block so testing a word reads a single cache line.  Since it is
+// much smaller than the lookup table that line is also far more
+// likely to already be in the cache.  The hash of the word used for
+// the lookup table is reused, thus the filter is case insensitive in
+// the same way the lookup table is.
+//
+
+static const u32int BLOOM_BLOCK_WORDS = 16;
+static const u32int BLOOM_BLOCK_BITS  = 512;
+
+// The filter's section starts with this, the blocks follow at the
+// next 64 byte boundary.
+struct BloomHead {
+  u32int num_blocks;
+  u32int num_hashes;
+};
+static const u32int BLOOM_HEAD_SIZE = 64;
+
+struct BloomPos {
+  u32int block, pos, step;
+  BloomPos(hash_int_t h0, u32int num_blocks) {
+    u32int h = (u32int)h0;
+    block = (h * 0x9E3779B1u) % num_blocks;
+    h ^= h >> 16; h *= 0x85EBCA6Bu;
+    h ^= h >> 13; h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    pos  = h % BLOOM_BLOCK_BITS;
+    step = (h / BLOOM_BLOCK_BITS) | 1;
+  }
+  void next() {pos = (pos + step) % BLOOM_BLOCK_BITS;}
+};
+
+struct BloomFilter {
+  const u32int * bits; // null if there is no filter
+  u32int num_blocks;
+  u32int num_hashes;
+  BloomFilter() : bits(0), num_blocks(0), num_hashes(0) {}
+  // returns false if the word with hash h is definitely not in the
+  // lookup table
+  bool maybe_contains(hash_int_t h) const {
+    if (!bits) return true;
+    BloomPos p(h, num_blocks);
+    const u32int * b = bits + p.block * BLOOM_BLOCK_WORDS;
+    for (u32int i = 0; i != num_hashes; ++i, p.next())
+      if (!(b[p.pos / 32] & (1u << p.pos % 32))) return false;
+    return true;
+  }
+};
+
+static inline void bloom_add(u32int * bits, u32int num_blocks, u32int num_hashes,
+                             hash_int_t h)
+{
+  BloomPos p(h, num_blocks);
+  u32int * b = bits + p.block * BLOOM_BLOCK_WORDS;
+  for (u32int i = 0; i != num_hashes; ++i, p.next())
+    b[p.pos / 32] |= 1u << p.pos % 32;
+}
+
 namespace {
 
   using namespace aspell::sp;
@@ -204,17 +305,14 @@ namespace {
     struct WordLookupParms {
       const char * block_begin;
       WordLookupParms() {}
-      typedef BlockVector<const u32int> Vector;
-      typedef u32int                    Value;
-      typedef const char *              Key;
-      static const bool is_multi = false;
+      typedef BlockVector<const HashGroup<u32int> > Vector;
+      typedef u32int                                Value;
+      typedef const char *                          Key;
       Key key(Value v) const {return block_begin + v;}
       InsensitiveHash<hash_int_t> hash;
       InsensitiveEqual equal;
-      bool is_nonexistent(Value v) const {return v == u32int_max;}
-      void make_nonexistent(const Value & v) const {abort();}
     };
-    typedef VectorHashTable<WordLookupParms> WordLookup;
+    typedef GroupedHashTable<WordLookupParms> WordLookup;
 
   public: // but don't use
       
@@ -225,8 +323,23 @@ namespace {
     const Jump * jump1;
     const Jump * jump2;
     WordLookup       word_lookup;
+    BloomFilter      bloom;
     const char *     word_block;
     const char *     first_word;
+
+    // the sections other than the words, which are what warm reads in
+    struct Range {const char * begin; const char * end;};
+    Vector<Range>    warm_ranges;
+
+    struct WarmTask : public Task {
+      const ReadOnlyDict * dict;
+      volatile bool stop;
+      void run();
+    };
+    Mutex            warm_lock;
+    bool             warm_started;
+    WarmTask         warm_task;
+    Thread           warm_thread;
     
     ReadOnlyDict(const ReadOnlyDict&);
     ReadOnlyDict& operator= (const ReadOnlyDict&);
@@ -243,9 +356,14 @@ namespace {
       : Dictionary(basic_dict, "ReadOnlyDict")
     {
       block = 0;
+      warm_started = false;
+      warm_task.dict = this;
+      warm_task.stop = false;
     }
 
     ~ReadOnlyDict() {
+      warm_task.stop = true;
+      warm_thread.join();
       if (block != 0) {
 	if (mmaped_block)
 	  mmap_free(mmaped_block, mmaped_size);
@@ -256,9 +374,12 @@ namespace {
     
     PosibErr<void> load(ParmString, Config &, DictList *, SpellerImpl *);
     PosibErr<void> check_hash_fun() const;
+    void warm();
     void low_level_dump() const;
 
     bool lookup(ParmString word, const SensitiveCompare *, WordEntry &) const;
+    void batch_lookup(const ParmString * words, unsigned num,
+                      const SensitiveCompare *, unsigned char * found) const;
 
     bool clean_lookup(ParmString, WordEntry &) const;
 
@@ -381,7 +502,7 @@ namespace {
     return word_lookup.empty();
   }
 
-  static const char * const cur_check_word = "aspell default speller rowl 1.10";
+  static const char * const cur_check_word = "aspell default speller rowl 2.2";
 
   struct DataHead {
     // all sizes except the last four must to divisible by "align":
@@ -390,15 +511,13 @@ namespace {
     u32int endian_check; // = 12345678
     char lang_hash[16];
 
-    u32int head_size;
+    u32int head_size;  // includes the names and the section directory
     u32int block_size;
-    u32int jump1_offset;
-    u32int jump2_offset;
-    u32int word_offset;
-    u32int hash_offset;
+    u32int section_dir_offset; // from the start of the file
+    u32int section_count;
 
     u32int word_count;
-    u32int word_buckets;
+    u32int word_groups;
     u32int soundslike_count;
 
     u32int dict_name_size;
@@ -415,6 +534,44 @@ namespace {
     byte freq_info;
   };
 
+  //
+  // The block that follows the head is divided into sections, each
+  // starting on a 64 byte boundary of the file so that it can be used
+  // in place when the file is mapped.  They are listed in the section
+  // directory in the head.  Sections a reader does not know are
+  // skipped unless they are marked as required, so new optional
+  // sections can be added without breaking existing readers.  The
+  // DataHead only holds the parameters of the required sections, any
+  // an optional section needs are stored at its start (see BloomHead).
+  //
+
+  enum SectionId {
+    JUMP1_SECTION = 1,
+    JUMP2_SECTION,
+    WORD_SECTION,
+    HASH_SECTION,
+    BLOOM_SECTION,
+    NUM_SECTION_IDS
+  };
+
+  struct SectionEntry {
+    static const unsigned int align = 64;
+    static const u32int required = 1; // flag
+    u32int id;
+    u32int flags;
+    u32int offset; // from the start of the block
+    u32int size;
+  };
+
+  // Reads a name of "size" bytes, which must end with a null.
+  static bool read_name(FStream & f, CharVector & word, u32int size)
+  {
+    if (size == 0) return false;
+    word.resize(size);
+    f.read(word.data(), size);
+    return word.data()[size - 1] == '\0';
+  }
+
   PosibErr<void> ReadOnlyDict::load(ParmString f0, Config & config, 
                                     DictList *, SpellerImpl *)
   {
@@ -441,13 +598,30 @@ namespace {
     if (data_head.endian_check != 12345678)
       return make_err(bad_file_format, fn, _("Wrong endian order."));
 
+    // the head and the block must fit in the file, and the names and
+    // the section directory in the head
+    struct stat st;
+    if (fstat(f.file_no(), &st) != 0
+        || (unsigned long long)st.st_size 
+           < (unsigned long long)data_head.head_size + data_head.block_size)
+      return make_err(bad_file_format, fn);
+    if (data_head.section_dir_offset > data_head.head_size
+        || data_head.section_count > (data_head.head_size - data_head.section_dir_offset) 
+                                     / sizeof(SectionEntry)
+        || data_head.section_dir_offset < sizeof(DataHead)
+        || (unsigned long long)data_head.dict_name_size + data_head.lang_name_size
+           + data_head.soundslike_name_size + data_head.soundslike_version_size
+           > data_head.section_dir_offset - sizeof(DataHead))
+      return make_err(bad_file_format, fn);
+
     CharVector word;
 
+    // the dict name is not used
     word.resize(data_head.dict_name_size);
     f.read(word.data(), data_head.dict_name_size);
 
-    word.resize(data_head.lang_name_size);
-    f.read(word.data(), data_head.lang_name_size);
+    if (!read_name(f, word, data_head.lang_name_size))
+      return make_err(bad_file_format, fn);
 
     PosibErr<void> pe = set_check_lang(word.data(),config);
     if (pe.has_err()) {
@@ -458,19 +632,50 @@ namespace {
     }
 
     if (data_head.soundslike_name_size != 0) {
-      word.resize(data_head.soundslike_name_size);
-      f.read(word.data(), data_head.soundslike_name_size);
+      if (!read_name(f, word, data_head.soundslike_name_size))
+        return make_err(bad_file_format, fn);
 
       if (strcmp(word.data(), lang()->soundslike_name()) != 0)
         return make_err(bad_file_format, fn, _("Wrong soundslike."));
 
-      word.resize(data_head.soundslike_version_size);
-      f.read(word.data(), data_head.soundslike_version_size);
+      if (!read_name(f, word, data_head.soundslike_version_size))
+        return make_err(bad_file_format, fn);
 
       if (strcmp(word.data(), lang()->soundslike_version()) != 0)
         return make_err(bad_file_format, fn, _("Wrong soundslike version."));
     }
 
+    Vector<SectionEntry> sections(data_head.section_count);
+    f.seek(data_head.section_dir_offset);
+    f.read(sections.pbegin(), sections.size() * sizeof(SectionEntry));
+
+    const SectionEntry * sect[NUM_SECTION_IDS] = {0};
+    for (unsigned i = 0; i != sections.size(); ++i) {
+      const SectionEntry & s = sections[i];
+      if (s.offset > data_head.block_size 
+          || s.size > data_head.block_size - s.offset
+          || s.offset % SectionEntry::align != 0)
+        return make_err(bad_file_format, fn);
+      for (unsigned j = 0; j != i; ++j) // sections may not overlap
+        if (s.size != 0 && sections[j].size != 0
+            && s.offset < sections[j].offset + sections[j].size
+            && sections[j].offset < s.offset + s.size)
+          return make_err(bad_file_format, fn);
+      if (s.id != 0 && s.id < NUM_SECTION_IDS) {
+        if (sect[s.id])
+          return make_err(bad_file_format, fn);
+        sect[s.id] = &s;
+      } else if (s.flags & SectionEntry::required)
+        return make_err(bad_file_format, fn, 
+                        _("It needs a newer version of Aspell."));
+    }
+    if (!sect[JUMP1_SECTION] || !sect[JUMP2_SECTION]
+        || !sect[WORD_SECTION] || !sect[HASH_SECTION])
+      return make_err(bad_file_format, fn);
+
+    if (data_head.affix_info && !lang()->have_affix())
+      return make_err(bad_file_format, fn);
+
     invisible_soundslike = data_head.invisible_soundslike;
     soundslike_root_only = data_head.soundslike_root_only;
 
@@ -478,10 +683,14 @@ namespace {
 
     block_size = data_head.block_size;
     int offset = data_head.head_size;
-    mmaped_block = mmap_open(block_size + offset, f, 0);
+    bool prefault = config.retrieve_bool("dict-prefault");
+    mmaped_block = mmap_open(block_size + offset, f, 0, prefault);
     if( mmaped_block != (char *)MAP_FAILED) {
       block = mmaped_block + offset;
       mmaped_size = block_size + offset;
+      mmap_advise(mmaped_block, mmaped_size, prefault,
+                  config.retrieve_bool("dict-huge-pages"),
+                  config.retrieve_bool("dict-lock"));
     } else {
       mmaped_block = 0;
       block = (char *)malloc(block_size);
@@ -489,31 +698,103 @@ namespace {
       f.read(block, block_size);
     }
 
-    if (data_head.jump2_offset) {
+    for (unsigned i = 0; i != sections.size(); ++i) {
+      const SectionEntry & s = sections[i];
+      if (s.id != WORD_SECTION && s.id != 0 && s.id < NUM_SECTION_IDS) {
+        Range r = {block + s.offset, block + s.offset + s.size};
+        warm_ranges.push_back(r);
+      }
+    }
+
+    // Check that what the sections are used for stays inside of them,
+    // so that a damaged file can not make lookups read past the end
+    // of the block.
+
+    u32int word_size = sect[WORD_SECTION]->size;
+    if (data_head.first_word_offset >= word_size)
+      return make_err(bad_file_format, fn);
+
+    if (data_head.word_groups == 0
+        || data_head.word_groups != sect[HASH_SECTION]->size / sizeof(HashGroup<u32int>))
+      return make_err(bad_file_format, fn);
+
+    {
       fast_scan = true;
-      jump1 = reinterpret_cast<const Jump *>(block + data_head.jump1_offset);
-      jump2 = reinterpret_cast<const Jump *>(block + data_head.jump2_offset);
-    } else {
-      jump1 = jump2 = 0;
+      jump1 = reinterpret_cast<const Jump *>(block + sect[JUMP1_SECTION]->offset);
+      jump2 = reinterpret_cast<const Jump *>(block + sect[JUMP2_SECTION]->offset);
+      // both tables end with an empty entry
+      u32int jump1_size = sect[JUMP1_SECTION]->size / sizeof(Jump);
+      u32int jump2_size = sect[JUMP2_SECTION]->size / sizeof(Jump);
+      if (jump1_size == 0 || jump1[jump1_size - 1].sl[0] != '\0'
+          || jump2_size == 0 || jump2[jump2_size - 1].sl[0] != '\0')
+        return make_err(bad_file_format, fn);
+      for (u32int i = 0; i != jump1_size; ++i)
+        if (jump1[i].loc >= jump2_size)
+          return make_err(bad_file_format, fn);
+      for (u32int i = 0; i != jump2_size; ++i)
+        if (jump2[i].loc >= word_size)
+          return make_err(bad_file_format, fn);
     }
 
-    word_block = block + data_head.word_offset;
+    word_block = block + sect[WORD_SECTION]->offset;
     first_word = word_block + data_head.first_word_offset;
 
     word_lookup.parms().block_begin = word_block;
     word_lookup.parms().hash .lang     = lang();
     word_lookup.parms().equal.cmp.lang = lang();
-    const u32int * begin = reinterpret_cast<const u32int *>
-      (block + data_head.hash_offset);
-    word_lookup.vector().set(begin, begin + data_head.word_buckets);
+    const HashGroup<u32int> * begin = reinterpret_cast<const HashGroup<u32int> *>
+      (block + sect[HASH_SECTION]->offset);
+    word_lookup.vector().set(begin, begin + data_head.word_groups);
     word_lookup.set_size(data_head.word_count);
+
+    if (sect[BLOOM_SECTION]) {
+      const char * b = block + sect[BLOOM_SECTION]->offset;
+      u32int size = sect[BLOOM_SECTION]->size;
+      if (size < BLOOM_HEAD_SIZE)
+        return make_err(bad_file_format, fn);
+      const BloomHead * head = reinterpret_cast<const BloomHead *>(b);
+      if (head->num_blocks == 0
+          || head->num_blocks > (size - BLOOM_HEAD_SIZE) / (BLOOM_BLOCK_WORDS * sizeof(u32int)))
+        return make_err(bad_file_format, fn);
+      bloom.bits = reinterpret_cast<const u32int *>(b + BLOOM_HEAD_SIZE);
+      bloom.num_blocks = head->num_blocks;
+      bloom.num_hashes = head->num_hashes;
+    }
+
     
     //low_level_dump();
     RET_ON_ERR(check_hash_fun());
+
+    if (config.retrieve_bool("dict-warm"))
+      warm();
     
     return no_err;
   }
 
+  // Reads a byte from each page so that the lookups that follow do
+  // not have to wait for the pages to be read from disk.
+  void ReadOnlyDict::WarmTask::run()
+  {
+    static const unsigned step = 4096; // no larger than any page size
+    volatile char sink = 0;
+    for (unsigned i = 0; i != dict->warm_ranges.size(); ++i) {
+      const char * end = dict->warm_ranges[i].end;
+      for (const char * p = dict->warm_ranges[i].begin; p < end && !stop; p += step)
+        sink += *p;
+    }
+  }
+
+  void ReadOnlyDict::warm()
+  {
+    LOCK(&warm_lock);
+    if (warm_started) return;
+    warm_started = true;
+    if (!mmaped_block) return; // already read in
+    for (unsigned i = 0; i != warm_ranges.size(); ++i)
+      mmap_will_need(warm_ranges[i].begin, warm_ranges[i].end);
+    warm_thread.start(&warm_task);
+  }
+
   void lookup_adv(WordEntry * wi);
 
   static inline void prep_next(WordEntry * wi, 
@@ -545,7 +826,9 @@ namespace {
                             WordEntry & o) const 
   {
     o.clear();
-    WordLookup::const_iterator i = word_lookup.find(word);
+    WordLookup::size_type h = word_lookup.hash(word);
+    if (!bloom.maybe_contains(h)) return false;
+    WordLookup::const_iterator i = word_lookup.find(word, h);
     if (i == word_lookup.end()) return false;
     const char * w = word_block + *i;
     for (;;) {
@@ -560,6 +843,51 @@ namespace {
     return false;
   }
 
+  // The lookups are done in groups.  For each group the hash of every
+  // word is computed and, unless the filter rules the word out, its
+  // hash group prefetched, then the first
+  // bucket whose tag matches is read and the word data it points to
+  // prefetched, and finally the words are compared.  This way the
+  // cache misses of the words in the group overlap rather than being
+  // taken one after another.
+  void ReadOnlyDict::batch_lookup(const ParmString * words, unsigned num,
+                                  const SensitiveCompare * c,
+                                  unsigned char * found) const
+  {
+    static const unsigned group_size = 16;
+    WordLookup::size_type hash[group_size];
+    bool maybe[group_size];
+    for (unsigned b = 0; b < num; b += group_size) {
+      unsigned e = b + group_size < num ? b + group_size : num;
+      for (unsigned i = b; i != e; ++i) {
+        maybe[i - b] = false;
+        if (found[i]) continue;
+        hash[i - b] = word_lookup.hash(words[i]);
+        if (!bloom.maybe_contains(hash[i - b])) continue;
+        maybe[i - b] = true;
+        word_lookup.prefetch(hash[i - b]);
+      }
+#ifdef __GNUC__
+      for (unsigned i = b; i != e; ++i) {
+        if (!maybe[i - b]) continue;
+        WordLookup::const_iterator j = word_lookup.first_candidate(hash[i - b]);
+        if (j != word_lookup.end()) __builtin_prefetch(word_block + *j);
+      }
+#endif
+      for (unsigned i = b; i != e; ++i) {
+        if (!maybe[i - b]) continue;
+        WordLookup::const_iterator j = word_lookup.find(words[i], hash[i - b]);
+        if (j == word_lookup.end()) continue;
+        const char * w = word_block + *j;
+        for (;;) {
+          if ((*c)(words[i], w)) {found[i] = 1; break;}
+          if (!duplicate_flag(w)) break;
+          w = get_next(w);
+        }
+      }
+    }
+  }
+
   struct ReadOnlyDict::SoundslikeElements : public SoundslikeEnumeration
   {
     WordEntry data;
@@ -684,7 +1012,7 @@ namespace {
     return new SoundslikeElements(this);
 
   }
-    
+
   static void soundslike_next(WordEntry * w)
   {
     const char * cur = (const char *)(w->intr[0]);
@@ -706,7 +1034,9 @@ namespace {
   bool ReadOnlyDict::clean_lookup(ParmString sl, WordEntry & o) const
   {
     o.clear();
-    WordLookup::const_iterator i = word_lookup.find(sl);
+    WordLookup::size_type h = word_lookup.hash(sl);
+    if (!bloom.maybe_contains(h)) return false;
+    WordLookup::const_iterator i = word_lookup.find(sl, h);
     if (i == word_lookup.end()) return false;
     const char * w = word_block + *i;
     convert(w, o);
@@ -795,29 +1125,31 @@ namespace {
   struct SoundslikeLess {
     InsensitiveCompare icomp;
     SoundslikeLess(const LangImpl * l) : icomp(l) {}
-    bool operator() (WordData * x, WordData * y) const {
+    bool operator() (const WordData * x, const WordData * y) const {
       int res = strcmp(x->sl, y->sl);
       if (res != 0) return res < 0;
       res = icomp(x->word, y->word);
       if (res != 0) return res < 0;
-      return strcmp(x->word, y->word) < 0;
+      res = strcmp(x->word, y->word);
+      if (res != 0) return res < 0;
+      // so that the order of the entries of a word does not depend on
+      // how the words were sorted
+      if (!x->aff || !y->aff) return !x->aff && y->aff;
+      return strcmp(x->aff, y->aff) < 0;
     }
   };
 
   struct WordLookupParms {
     const char * block_begin;
     WordLookupParms() {}
-    typedef aspell::Vector<u32int> Vector;
-    typedef u32int                 Value;
-    typedef const char *           Key;
-    static const bool is_multi = false;
+    typedef aspell::Vector<HashGroup<u32int> > Vector;
+    typedef u32int                             Value;
+    typedef const char *                       Key;
     Key key(Value v) const {return block_begin + v;}
     InsensitiveHash<hash_int_t> hash;
     InsensitiveEqual equal;
-    bool is_nonexistent(Value v) const {return v == u32int_max;}
-    void make_nonexistent(Value & v) const {v = u32int_max;}
   };
-  typedef VectorHashTable<WordLookupParms> WordLookup;
+  typedef GroupedHashTable<WordLookupParms> WordLookup;
 
   static inline unsigned int round_up(unsigned int i, unsigned int size) {
     return ((i + size - 1)/size)*size;
@@ -830,12 +1162,386 @@ namespace {
       out << '\0';
   }
 
+  // Starts a section at the next aligned position of the file
+  static void start_section(FStream & out, const DataHead & head,
+                            Vector<SectionEntry> & sections, 
+                            u32int id, u32int flags) 
+  {
+    advance_file(out, round_up(out.tell(), SectionEntry::align));
+    SectionEntry s;
+    s.id = id;
+    s.flags = flags;
+    s.offset = out.tell() - head.head_size;
+    s.size = 0;
+    sections.push_back(s);
+  }
+
+  static void end_section(FStream & out, const DataHead & head,
+                          Vector<SectionEntry> & sections) 
+  {
+    sections.back().size = out.tell() - head.head_size - sections.back().offset;
+  }
+
+  //
+  // The words are read in batches and the affixes of the words in
+  // each batch are expanded, and their soundslikes computed, by up to
+  // "create-threads" threads at once.  The resulting WordData are
+  // kept in memory until they use more than "create-memory"
+  // megabytes.  They are then sorted and written to a temporary file
+  // as a run, and once all words are read the runs are merged.  When
+  // everything fits in memory no temporary file is used.
+  //
+
+  static const unsigned create_batch_size = 8192; // words per thread
+
+  struct InputWord {
+    const char * word;
+    const char * aff;
+  };
+
+  class ExpandTask : public Task {
+  public:
+    const LangImpl * lang;
+    bool affix_compress;
+    bool partially_expand;
+    const InputWord * begin;
+    const InputWord * end;
+    ObjStack   buf;      // holds the WordData until they are written
+    size_t     used;     // the number of bytes used in buf
+    WordData * first;    // the words from this batch
+    WordData * last;
+    String     bad_word; // the first word which is too long, if any
+    ExpandTask() : buf(16*1024), used(0) {}
+    void run();
+  private:
+    ObjStack exp_buf;
+    String   sl_buf;
+  };
+
+  void ExpandTask::run()
+  {
+    first = last = 0;
+    bad_word.clear();
+    WordData * * prev = &first;
+    WordAff * exp_list;
+    WordAff single;
+    single.next = 0;
+
+    for (const InputWord * i = begin; i != end; ++i) {
+
+      const char * w = i->word;
+      const char * affixes = i->aff;
+
+      if (*affixes && !affix_compress) {
+        exp_buf.reset();
+        exp_list = lang->affix()->expand(w, affixes, exp_buf);
+      } else if (*affixes && partially_expand) {
+        // expand any affixes which will effect the first
+        // 3 letters of a word.  This is needed so that the
+        // jump tables will function correctly
+        exp_buf.reset();
+        exp_list = lang->affix()->expand(w, affixes, exp_buf, 3);
+      } else {
+        single.word.str = w;
+        single.word.size = strlen(w);
+        single.aff = (const byte *)affixes;
+        exp_list = &single;
+      }
+
+      // iterate through each expanded word
+
+      for (WordAff * p = exp_list; p; p = p->next)
+      {
+        const char * w = p->word.str;
+        unsigned s = p->word.size;
+
+        unsigned total_size = WordData::struct_size;
+        unsigned data_size = s + 1;
+        unsigned aff_size = strlen((const char *)p->aff);
+        if (aff_size > 0) data_size += aff_size + 1;
+        total_size += data_size;
+        lang->to_soundslike(sl_buf, w);
+        const char * sl = sl_buf.str();
+        unsigned sl_size = sl_buf.size();
+        if (strcmp(sl,w) == 0) sl = w;
+        if (sl != w) total_size += sl_size + 1;
+
+        if (total_size - WordData::struct_size > 240) {
+          bad_word = w;
+          return;
+        }
+
+        WordData * b = (WordData *)buf.alloc(total_size, sizeof(void *));
+        used += total_size;
+        *prev = b;
+        b->next = 0;
+        prev = &b->next;
+        last = b;
+
+        b->word_size = s;
+        b->sl_size = strlen(sl);
+        b->data_size = data_size;
+        b->flags = lang->get_word_info(w);
+
+        char * z = b->word;
+
+        memcpy(z, w, s + 1);
+        z += s + 1;
+
+        if (aff_size > 0) {
+          b->flags |= HAVE_AFFIX_FLAG;
+          b->aff = z;
+          memcpy(z, p->aff, aff_size + 1);
+          z += aff_size + 1;
+        } else {
+          b->aff = 0;
+        }
+
+        if (sl != w) {
+          memcpy(z, sl, sl_size + 1);
+          b->sl = z;
+        } else {
+          b->sl = b->word;
+        }
+
+      }
+    }
+  }
+
+  // Copies "w" into "buf", but with the affix flags "aff".
+  static WordData * copy_word_data(String & buf, const WordData * w,
+                                   const char * aff, byte flags)
+  {
+    unsigned aff_size = aff ? strlen(aff) + 1 : 0;
+    unsigned sl_size = w->sl != w->word ? w->sl_size + 1 : 0;
+    buf.resize(WordData::struct_size + w->word_size + 1 + aff_size + sl_size);
+    WordData * b = (WordData *)buf.data();
+    b->next = 0;
+    b->word_size = w->word_size;
+    b->sl_size = w->sl_size;
+    b->data_size = w->word_size + 1 + aff_size;
+    b->flags = flags;
+    char * z = b->word;
+    memcpy(z, w->word, w->word_size + 1);
+    z += w->word_size + 1;
+    b->aff = aff ? z : 0;
+    memcpy(z, aff, aff_size);
+    z += aff_size;
+    b->sl = sl_size ? z : b->word;
+    memcpy(z, w->sl, sl_size);
+    return b;
+  }
+
+  static inline WordData * copy_word_data(String & buf, const WordData * w)
+  {
+    return copy_word_data(buf, w, w->aff, w->flags);
+  }
+
+  static void write_word_data(FStream & out, const WordData * w)
+  {
+    unsigned aff_size = w->aff ? strlen(w->aff) + 1 : 0;
+    unsigned sl_size = w->sl != w->word ? w->sl_size + 1 : 0;
+    byte head[6] = {w->word_size, w->sl_size, w->data_size, w->flags,
+                    (byte)aff_size, (byte)sl_size};
+    out.write(head, 6);
+    out.write(w->word, w->word_size + 1);
+    out.write(w->aff, aff_size);
+    out.write(w->sl, sl_size);
+  }
+
+  // returns 0 at the end of the file
+  static WordData * read_word_data(FStream & in, String & buf)
+  {
+    byte head[6];
+    if (!in.read(head, 6)) return 0;
+    unsigned word_size = head[0];
+    unsigned aff_size = head[4];
+    unsigned sl_size = head[5];
+    unsigned size = word_size + 1 + aff_size + sl_size;
+    buf.resize(WordData::struct_size + size);
+    WordData * b = (WordData *)buf.data();
+    in.read(b->word, size);
+    b->next = 0;
+    b->word_size = word_size;
+    b->sl_size = head[1];
+    b->data_size = head[2];
+    b->flags = head[3];
+    b->aff = aff_size ? b->word + word_size + 1 : 0;
+    b->sl = sl_size ? b->word + word_size + 1 + aff_size : b->word;
+    return b;
+  }
+
+  // A source of WordData in sorted order.  A WordData returned by
+  // next stays valid until the next call.
+  class WordDataSource {
+  public:
+    virtual WordData * next() = 0;
+    virtual ~WordDataSource() {}
+  };
+
+  class WordDataList : public WordDataSource {
+    WordData * cur_;
+  public:
+    WordDataList(WordData * f) : cur_(f) {}
+    WordData * next() {
+      WordData * w = cur_;
+      if (cur_) cur_ = cur_->next;
+      return w;
+    }
+  };
+
+  // Merges the sorted runs.  When two words compare equal the one from
+  // the earlier run comes first, thus the result is the same as if all
+  // the words had been sorted at once.
+  class WordDataMerge : public WordDataSource {
+    struct Run {
+      FStream    in;
+      String     buf;
+      WordData * cur;
+      Run(FILE * f) : in(f), cur(0) {}
+    };
+    Vector<Run *>    runs_;
+    Vector<unsigned> heap_; // of the runs not at the end
+    int              last_; // the run of the word last returned
+    SoundslikeLess   less_;
+    // the heap is ordered so that the run with the next word is first
+    struct After {
+      const WordDataMerge * m;
+      After(const WordDataMerge * m0) : m(m0) {}
+      bool operator() (unsigned x, unsigned y) const {
+        const WordData * a = m->runs_[x]->cur;
+        const WordData * b = m->runs_[y]->cur;
+        if (m->less_(b, a)) return true;
+        if (m->less_(a, b)) return false;
+        return x > y;
+      }
+    };
+    friend struct After;
+    WordDataMerge(const WordDataMerge &);
+    void operator=(const WordDataMerge &);
+  public:
+    WordDataMerge(const LangImpl * l) : last_(-1), less_(l) {}
+    ~WordDataMerge() {
+      for (Vector<Run *>::iterator i = runs_.begin(); i != runs_.end(); ++i)
+        delete *i;
+    }
+    unsigned size() const {return runs_.size();}
+    PosibErr<void> add_run(WordData * first);
+    void start();
+    WordData * next();
+  };
+
+  PosibErr<void> WordDataMerge::add_run(WordData * first)
+  {
+    FILE * f = tmpfile();
+    if (!f)
+      return make_err(other_error, _("Unable to create a temporary file."));
+    Run * r = new Run(f);
+    runs_.push_back(r);
+    for (; first; first = first->next)
+      write_word_data(r->in, first);
+    r->in.flush();
+    if (!r->in)
+      return make_err(other_error, _("Unable to write to a temporary file."));
+    return no_err;
+  }
+
+  void WordDataMerge::start()
+  {
+    for (unsigned i = 0; i != runs_.size(); ++i) {
+      runs_[i]->in.seek(0);
+      runs_[i]->cur = read_word_data(runs_[i]->in, runs_[i]->buf);
+      if (runs_[i]->cur) heap_.push_back(i);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), After(this));
+  }
+
+  WordData * WordDataMerge::next()
+  {
+    if (last_ >= 0) {
+      Run * r = runs_[last_];
+      r->cur = read_word_data(r->in, r->buf);
+      if (r->cur) {
+        heap_.push_back(last_);
+        std::push_heap(heap_.begin(), heap_.end(), After(this));
+      }
+      last_ = -1;
+    }
+    if (heap_.empty()) return 0;
+    std::pop_heap(heap_.begin(), heap_.end(), After(this));
+    last_ = heap_.back();
+    heap_.pop_back();
+    return runs_[last_]->cur;
+  }
+
+  // Removes duplicate words from the sorted words and marks the words
+  // which only differ in case.  The last word is not counted in
+  // num_entries or uniq_entries, as has always been the case.
+  class WordDataUnique : public WordDataSource {
+    WordDataSource * src_;
+    InsensitiveEqual ieq_;
+    String           prev_buf_;
+    String           out_buf_;
+    WordData *       prev_;
+  public:
+    int num_entries;
+    int uniq_entries;
+    WordDataUnique(WordDataSource * src, const LangImpl * l)
+      : src_(src), ieq_(l), prev_(0), num_entries(0), uniq_entries(0)
+    {
+      WordData * w = src_->next();
+      if (w) prev_ = copy_word_data(prev_buf_, w);
+    }
+    WordData * next();
+  };
+
+  WordData * WordDataUnique::next()
+  {
+    if (!prev_) return 0;
+    for (;;) {
+      WordData * cur = src_->next();
+      if (!cur) {
+        prev_ = 0;
+        prev_buf_.swap(out_buf_);
+        return (WordData *)out_buf_.data();
+      }
+      if (strcmp(prev_->word, cur->word) == 0) {
+        if (!prev_->aff && cur->aff) {
+          // merge affix info into previous word
+          prev_ = copy_word_data(out_buf_, prev_, cur->aff,
+                                 prev_->flags | HAVE_AFFIX_FLAG);
+          prev_buf_.swap(out_buf_);
+          continue;
+        } else if (prev_->aff && cur->aff) {
+          // don't merge affix info, store both entries
+          prev_->flags |= DUPLICATE_FLAG;
+          ++num_entries;
+        } else {
+          // ignore this word
+          continue;
+        }
+      } else {
+        if (ieq_(prev_->word, cur->word)) prev_->flags |= DUPLICATE_FLAG;
+        else ++uniq_entries;
+        ++num_entries;
+      }
+      prev_buf_.swap(out_buf_);
+      prev_ = copy_word_data(prev_buf_, cur);
+      return (WordData *)out_buf_.data();
+    }
+  }
+
+  struct ExpandTasks : public Vector<ExpandTask *> {
+    ~ExpandTasks() {for (iterator i = begin(); i != end(); ++i) delete *i;}
+  };
+
   PosibErr<void> create (StringEnumeration * els,
 			 const LangImpl & lang,
                          Config & config) 
   {
     assert(sizeof(u16int) == 2);
     assert(sizeof(u32int) == 4);
+    assert(sizeof(HashGroup<u32int>) == 64);
 
     bool full_soundslike = !(strcmp(lang.soundslike_name(), "none") == 0 ||
                              strcmp(lang.soundslike_name(), "stripped") == 0 ||
@@ -876,12 +1582,13 @@ namespace {
     data_head.lang_name_size = strlen(lang.name()) + 1;
     data_head.soundslike_name_size    = strlen(lang.soundslike_name()) + 1;
     data_head.soundslike_version_size = strlen(lang.soundslike_version()) + 1;
-    data_head.head_size  = sizeof(DataHead);
-    data_head.head_size += data_head.dict_name_size;
-    data_head.head_size += data_head.lang_name_size;
-    data_head.head_size += data_head.soundslike_name_size;
-    data_head.head_size += data_head.soundslike_version_size;
-    data_head.head_size  = round_up(data_head.head_size, DataHead::align);
+    data_head.section_dir_offset  = sizeof(DataHead);
+    data_head.section_dir_offset += data_head.dict_name_size;
+    data_head.section_dir_offset += data_head.lang_name_size;
+    data_head.section_dir_offset += data_head.soundslike_name_size;
+    data_head.section_dir_offset += data_head.soundslike_version_size;
+    data_head.section_dir_offset  = round_up(data_head.section_dir_offset, 
+                                             DataHead::align);
 
     data_head.affix_info = affix_compress ? partially_expand ? 1 : 2 : 0;
     data_head.invisible_soundslike = invisible_soundslike;
@@ -897,15 +1604,22 @@ namespace {
     CERR.printl("---");
 #endif
     
-    String temp;
-
-    int num_entries = 0;
-    int uniq_entries = 0;
-    
-    ObjStack buf(16*1024);
-    String sl_buf;
+    unsigned num_threads = config.retrieve_int("create-threads");
+    if (num_threads == 0) num_threads = num_processors();
+    size_t memory_limit = (size_t)config.retrieve_int("create-memory") << 20;
+
+    ExpandTasks tasks;
+    for (unsigned i = 0; i != num_threads; ++i) {
+      ExpandTask * t = new ExpandTask;
+      t->lang = &lang;
+      t->affix_compress = affix_compress;
+      t->partially_expand = partially_expand;
+      tasks.push_back(t);
+    }
 
     WordData * first = 0;
+    WordData * * prev = &first;
+    WordDataMerge runs(&lang);
 
     //
     // Read in Wordlist
@@ -913,198 +1627,107 @@ namespace {
     {
       WordListIterator wl_itr(els, &lang, config.retrieve_bool("warn") ? &CERR : 0);
       wl_itr.init(config);
-      ObjStack exp_buf;
-      WordAff * exp_list;
-      WordAff single;
-      single.next = 0;
-      Vector<WordAff> af_list;
-      WordData * * prev = &first;
-
-      for (;;) {
-
-        PosibErr<bool> pe = wl_itr.adv();
-        if (pe.has_err()) return pe;
-        if (!pe.data) break;
-
-        const char * w = wl_itr->word.str;
-        unsigned int s = wl_itr->word.size;
-
-        const char * affixes = wl_itr->aff.str;
-
-        if (*affixes && !lang.affix())
-          return make_err(other_error, 
-                          _("Affix flags found in word but no affix file given."));
-
-        if (*affixes && !affix_compress) {
-          exp_buf.reset();
-          exp_list = lang.affix()->expand(w, affixes, exp_buf);
-        } else if (*affixes && partially_expand) {
-          // expand any affixes which will effect the first
-          // 3 letters of a word.  This is needed so that the
-          // jump tables will function correctly
-          exp_buf.reset();
-          exp_list = lang.affix()->expand(w, affixes, exp_buf, 3);
-        } else {
-          single.word.str = w;
-          single.word.size = strlen(w);
-          single.aff = (const byte *)affixes;
-          exp_list = &single;
+      ObjStack in_buf;
+      Vector<InputWord> batch;
+      const unsigned max_batch = create_batch_size * num_threads;
+      batch.reserve(max_batch);
+      PosibErr<void> read_err;
+      bool at_end = false;
+
+      while (!at_end) {
+
+        in_buf.reset();
+        batch.clear();
+        while (batch.size() != max_batch) {
+          PosibErr<bool> pe = wl_itr.adv();
+          if (pe.has_err()) {read_err = pe; at_end = true; break;}
+          if (!pe.data) {at_end = true; break;}
+          InputWord w;
+          w.word = in_buf.dup(wl_itr->word);
+          w.aff = in_buf.dup(wl_itr->aff);
+          if (*w.aff && !lang.affix()) {
+            read_err = make_err(other_error, 
+                                _("Affix flags found in word but no affix file given."));
+            at_end = true;
+            break;
+          }
+          batch.push_back(w);
         }
 
-        // iterate through each expanded word
-        
-        for (WordAff * p = exp_list; p; p = p->next)
-        {
-          const char * w = p->word.str;
-          s = p->word.size;
-          
-          unsigned total_size = WordData::struct_size;
-          unsigned data_size = s + 1;
-          unsigned aff_size = strlen((const char *)p->aff);
-          if (aff_size > 0) data_size += aff_size + 1;
-          total_size += data_size;
-          lang.to_soundslike(sl_buf, w);
-          const char * sl = sl_buf.str();
-          unsigned sl_size = sl_buf.size();
-          if (strcmp(sl,w) == 0) sl = w;
-          if (sl != w) total_size += sl_size + 1;
-
-          if (total_size - WordData::struct_size > 240)
-            return make_err(invalid_word, MsgConv(lang)(w),
+        // give each thread an equal share of the batch
+        unsigned n = batch.size();
+        for (unsigned i = 0; i != num_threads; ++i) {
+          tasks[i]->begin = batch.pbegin() + n * i / num_threads;
+          tasks[i]->end = batch.pbegin() + n * (i + 1) / num_threads;
+        }
+        run_parallel((Task * const *)tasks.pbegin(), 
+                     (Task * const *)tasks.pend(), num_threads);
+
+        size_t used = 0;
+        for (unsigned i = 0; i != num_threads; ++i) {
+          ExpandTask * t = tasks[i];
+          if (!t->bad_word.empty())
+            return make_err(invalid_word, MsgConv(lang)(t->bad_word),
                             _("The total word length, with soundslike data, is larger than 240 characters."));
-
-          WordData * b = (WordData *)buf.alloc(total_size, sizeof(void *));
-          *prev = b;
-          b->next = 0;
-          prev = &b->next;
-          
-          b->word_size = s;
-          b->sl_size = strlen(sl);
-          b->data_size = data_size;
-          b->flags = lang.get_word_info(w);
-
-          char * z = b->word;
-
-          memcpy(z, w, s + 1);
-          z += s + 1;
-
-          if (aff_size > 0) {
-            b->flags |= HAVE_AFFIX_FLAG;
-            b->aff = z;
-            memcpy(z, p->aff, aff_size + 1);
-            z += aff_size + 1;
-          } else {
-            b->aff = 0;
+          if (t->first) {
+            *prev = t->first;
+            prev = &t->last->next;
           }
-
-          if (sl != w) {
-            memcpy(z, sl, sl_size + 1);
-            b->sl = z;
-          } else {
-            b->sl = b->word;
+          used += t->used;
+        }
+        if (read_err.has_err()) return read_err;
+
+        // write out a sorted run if too much memory is used
+        if (used > memory_limit && first) {
+          RET_ON_ERR(runs.add_run(sort(first, SoundslikeLess(&lang))));
+          first = 0;
+          prev = &first;
+          for (unsigned i = 0; i != num_threads; ++i) {
+            tasks[i]->buf.reset();
+            tasks[i]->used = 0;
           }
-
         }
       }
       delete els;
     }
 
     //
-    // sort WordData linked list based on (sl, word)
-    //
-
-    first = sort(first, SoundslikeLess(&lang));
-
-    //
-    // duplicate check
-    // 
-    WordData * prev = first;
-    WordData * cur = first ? first->next : 0;
-    InsensitiveEqual ieq(&lang);
-    while (cur) {
-      if (strcmp(prev->word, cur->word) == 0) {
-        if (!prev->aff && cur->aff) {
-          // merge affix info into previous word
-          prev->flags |= HAVE_AFFIX_FLAG;
-          prev->aff = cur->aff;
-          prev->data_size += strlen(prev->aff) + 1;
-          prev->next = cur->next;
-        } else if (prev->aff && cur->aff) {
-          // don't merge affix info, store both entries
-          prev->flags |= DUPLICATE_FLAG;
-          ++num_entries;
-          prev = cur;
-        } else {
-          // ignore this word
-          prev->next = cur->next;
-        }
-      } else {
-        if (ieq(prev->word, cur->word)) prev->flags |= DUPLICATE_FLAG;
-        else ++uniq_entries;
-        ++num_entries;
-        prev = cur;
-      }
-      cur = cur->next;
-    }
-
-    //
+    // sort WordData linked list based on (sl, word), merging the runs
+    // if there are any, and remove the duplicates
     //
-    //
-
-    unsigned data_size = 16;
-    WordData * p = first;
-    if (invisible_soundslike) {
-      
-      for (; p; p = p->next)
-        data_size += 3 + p->data_size;
 
+    WordDataList list(0);
+    WordDataSource * sorted = &list;
+    if (runs.size() == 0) {
+      list = WordDataList(sort(first, SoundslikeLess(&lang)));
     } else {
-
-      while (p)
-      {
-        unsigned ds = 2 + p->sl_size + 1;
-
-        char * prev = p->sl;
-
-        do {
-          
-          ds += 3 + p->data_size;
-          p->sl = prev;
-          p = p->next;
-
-        } while (p && strcmp(prev, p->sl) == 0 && ds + 3 + p->data_size < 255);
-
-        data_size += ds;
-
-      }
-
+      if (first)
+        RET_ON_ERR(runs.add_run(sort(first, SoundslikeLess(&lang))));
+      for (unsigned i = 0; i != num_threads; ++i)
+        tasks[i]->buf.reset();
+      runs.start();
+      sorted = &runs;
     }
+    WordDataUnique uniq(sorted, &lang);
 
     //
     // Create the final data structures
     //
 
     CharVector     data;
-    data.reserve(data_size);
     data.write32(0); // to avoid nasty special cases
     unsigned int prev_pos = data.size();
     data.write32(0);
     unsigned prev_w_pos = data.size();
-
-    WordLookup lookup(affix_compress 
-                      ? uniq_entries * 3 / 2 
-                      : uniq_entries * 5 / 4);
-    lookup.parms().block_begin = data.begin();
-    lookup.parms().hash .lang     = &lang;
-    lookup.parms().equal.cmp.lang = &lang;
+    Vector<u32int> word_pos;
 
     Vector<Jump> jump1;
     Vector<Jump> jump2;
 
     const int head_size = invisible_soundslike ? 3 : 2;
 
-    const char * prev_sl = "";
-    p = first;
+    String prev_sl;
+    WordData * p = uniq.next();
     while (p)
     {
       if (invisible_soundslike) {
@@ -1120,14 +1743,14 @@ namespace {
 
       }
         
-      if (strncmp(prev_sl, p->sl, 3) != 0) {
+      if (strncmp(prev_sl.str(), p->sl, 3) != 0) {
         
         Jump jump;
         strncpy(jump.sl, p->sl, 3);
         jump.loc = data.size();
         jump2.push_back(jump);
         
-        if (strncmp(prev_sl, p->sl, 2) != 0) {
+        if (strncmp(prev_sl.str(), p->sl, 2) != 0) {
           Jump jump;
           strncpy(jump.sl, p->sl, 2);
           jump.loc = jump2.size() - 1;
@@ -1147,6 +1770,7 @@ namespace {
       }
         
       prev_pos = data.size();
+
       prev_sl = p->sl;
 
       if (invisible_soundslike) {
@@ -1155,15 +1779,18 @@ namespace {
         prev_w_pos = data.size();
         data.write(p->word, p->word_size + 1);
         if (p->aff) data.write(p->aff, p->data_size - p->word_size - 1);
-        lookup.insert(pos);
+        word_pos.push_back(pos);
 
-        p = p->next;
+        p = uniq.next();
 
       } else {
 
         data.write(p->sl, p->sl_size + 1);
 
-        // write all word entries with the same soundslike
+        // write all word entries with the same soundslike, as long as
+        // the group stays under 255 bytes
+
+        unsigned ds = 2 + p->sl_size + 1;
 
         do {
           data.write(p->flags);
@@ -1174,17 +1801,21 @@ namespace {
           data[prev_w_pos - NEXT_O] = (byte)(pos - prev_w_pos);
           data.write(p->word, p->word_size + 1);
           if (p->aff) data.write(p->aff, p->data_size - p->word_size - 1);
-          lookup.insert(pos);
+          word_pos.push_back(pos);
 
           prev_w_pos = pos;
-          prev_sl = p->sl;
+          ds += 3 + p->data_size;
 
-          p = p->next;
+          p = uniq.next();
 
-        } while (p && prev_sl == p->sl); // yes I really mean to use pointer compare here
+        } while (p && strcmp(prev_sl.str(), p->sl) == 0 
+                 && ds + 3 + p->data_size < 255);
       }
     }
 
+    int num_entries = uniq.num_entries;
+    int uniq_entries = uniq.uniq_entries;
+
     // add special end case
     if (data.size() % 2 != 0) data.write('\0');
     data.write16(0);
@@ -1198,6 +1829,38 @@ namespace {
     data.write(0);
     data.write(0);
 
+    //
+    // Create the hash table and bloom filter now that the data block
+    // will no longer move
+    //
+
+    WordLookup lookup(affix_compress 
+                      ? uniq_entries * 3 / 2 
+                      : uniq_entries * 5 / 4);
+    lookup.parms().block_begin = data.begin();
+    lookup.parms().hash .lang     = &lang;
+    lookup.parms().equal.cmp.lang = &lang;
+
+    // about 0.7 * bits per word hashes is optimal
+    unsigned bloom_bits = config.retrieve_int("bloom-filter-bits");
+    u32int bloom_blocks = 0, bloom_hashes = 0;
+    if (bloom_bits > 0) {
+      bloom_blocks = (uniq_entries * bloom_bits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+      if (bloom_blocks == 0) bloom_blocks = 1;
+      bloom_hashes = (bloom_bits * 7 + 5) / 10;
+      if (bloom_hashes > 16) bloom_hashes = 16;
+    }
+    Vector<u32int> bloom(bloom_blocks * BLOOM_BLOCK_WORDS, 0);
+
+    for (Vector<u32int>::const_iterator i = word_pos.begin(); 
+         i != word_pos.end(); ++i) 
+    {
+      lookup.insert(*i);
+      if (bloom_blocks)
+        bloom_add(bloom.pbegin(), bloom_blocks, bloom_hashes, 
+                  lookup.hash(data.begin() + *i));
+    }
+
     if (invisible_soundslike)
       data_head.first_word_offset = data[4 - NEXT_O] + 4;
     else
@@ -1209,7 +1872,14 @@ namespace {
     //assert(lookup.size() == uniq_entries);
 
     data_head.word_count   = num_entries;
-    data_head.word_buckets = lookup.bucket_count();
+    data_head.word_groups  = lookup.vector().size();
+
+    data_head.section_count = 4;
+    if (bloom_blocks) ++data_head.section_count;
+    data_head.head_size = round_up(data_head.section_dir_offset 
+                                   + data_head.section_count * sizeof(SectionEntry),
+                                   SectionEntry::align);
+    Vector<SectionEntry> sections;
 
     FStream out;
     out.open(base, "wb");
@@ -1217,26 +1887,43 @@ namespace {
     advance_file(out, data_head.head_size);
 
     // Write jump1 table
-    data_head.jump1_offset = out.tell() - data_head.head_size;
+    start_section(out, data_head, sections, JUMP1_SECTION, SectionEntry::required);
     out.write(jump1.data(), jump1.size() * sizeof(Jump));
+    end_section(out, data_head, sections);
     
     // Write jump2 table
-    advance_file(out, round_up(out.tell(), DataHead::align));
-    data_head.jump2_offset = out.tell() - data_head.head_size;
+    start_section(out, data_head, sections, JUMP2_SECTION, SectionEntry::required);
     out.write(jump2.data(), jump2.size() * sizeof(Jump));
+    end_section(out, data_head, sections);
 
     // Write data block
-    advance_file(out, round_up(out.tell(), DataHead::align));
-    data_head.word_offset = out.tell() - data_head.head_size;
+    start_section(out, data_head, sections, WORD_SECTION, SectionEntry::required);
     out.write(data.data(), data.size());
+    end_section(out, data_head, sections);
+
+    // Write hash, each group is in one cache line when the file is
+    // mmaped
+    start_section(out, data_head, sections, HASH_SECTION, SectionEntry::required);
+    out.write(&lookup.vector().front(), 
+              lookup.vector().size() * sizeof(HashGroup<u32int>));
+    end_section(out, data_head, sections);
+
+    // Write the filter, each block in one cache line
+    if (bloom_blocks) {
+      start_section(out, data_head, sections, BLOOM_SECTION, 0);
+      BloomHead head;
+      head.num_blocks = bloom_blocks;
+      head.num_hashes = bloom_hashes;
+      out.write(&head, sizeof(BloomHead));
+      advance_file(out, out.tell() - sizeof(BloomHead) + BLOOM_HEAD_SIZE);
+      out.write(bloom.pbegin(), bloom.size() * sizeof(u32int));
+      end_section(out, data_head, sections);
+    }
 
-    // Write hash
-    advance_file(out, round_up(out.tell(), DataHead::align));
-    data_head.hash_offset = out.tell() - data_head.head_size;
-    out.write(&lookup.vector().front(), lookup.vector().size() * 4);
+    assert(sections.size() == data_head.section_count);
     
     // calculate block size
-    advance_file(out, round_up(out.tell(), DataHead::align));
+    advance_file(out, round_up(out.tell(), SectionEntry::align));
     data_head.block_size = out.tell() - data_head.head_size;
 
     // write data head to file
@@ -1247,6 +1934,10 @@ namespace {
     out.write(lang.soundslike_name(), data_head.soundslike_name_size);
     out.write(lang.soundslike_version(), data_head.soundslike_version_size);
 
+    // write the section directory
+    out.seek(data_head.section_dir_offset);
+    out.write(sections.pbegin(), sections.size() * sizeof(SectionEntry));
+
     return no_err;
   }
 
@@ -1262,6 +1953,17 @@ namespace aspell { namespace sp {
     lang.reset(res.data);
     lang->set_lang_defaults(config);
     RET_ON_ERR(create(els,*lang,config));
+    if (lang->affix()) {
+      // also write out the compiled affix data so it doesn't have to
+      // be parsed again, failing is not an error as the data
+      // directory may not be writable
+      String file;
+      file += lang->data_dir();
+      file += '/';
+      file += lang->name();
+      file += "_affix.dat";
+      lang->affix()->write_image(affix_image_file(file)).ignore_err();
+    }
     return no_err;
   }
 } }
@@ -49,17 +49,26 @@ namespace aspell { namespace sp {
   // Spell check methods
   //
 
+  static PosibErr<void> frozen_error()
+  {
+    return make_err(operation_not_supported_error, 
+                    _("The speller is frozen."));
+  }
+
   PosibErr<void> SpellerImpl::add_to_personal(MutableString word) {
+    if (frozen_) return frozen_error();
     if (!personal_) return no_err;
     return personal_->add(word);
   }
   
   PosibErr<void> SpellerImpl::add_to_session(MutableString word) {
+    if (frozen_) return frozen_error();
     if (!session_) return no_err;
     return session_->add(word);
   }
 
   PosibErr<void> SpellerImpl::clear_session() {
+    if (frozen_) return frozen_error();
     if (!session_) return no_err;
     return session_->clear();
   }
@@ -67,6 +76,7 @@ namespace aspell { namespace sp {
   PosibErr<void> SpellerImpl::store_replacement(MutableString mis, 
                                                 MutableString cor)
   {
+    if (frozen_) return frozen_error();
     return SpellerImpl::store_replacement(mis,cor,true);
   }
 
@@ -133,7 +143,7 @@ namespace aspell { namespace sp {
     return &suggest_->suggest(word);
   }
 
-  bool SpellerImpl::check_simple (ParmString w, WordEntry & w0) 
+  bool SpellerImpl::check_simple (ParmString w, WordEntry & w0) const
   {
     w0.clear(); // FIXME: is this necessary?
     const char * x = w;
@@ -148,7 +158,7 @@ namespace aspell { namespace sp {
     return false;
   };
 
-  bool SpellerImpl::check_affix(ParmString word, IntrCheckInfo & ci, GuessInfo * gi)
+  bool SpellerImpl::check_affix(ParmString word, IntrCheckInfo & ci, GuessInfo * gi) const
   {
     WordEntry w;
     bool res = check_simple(word, w);
@@ -165,7 +175,7 @@ namespace aspell { namespace sp {
 
   inline bool SpellerImpl::check2(char * word, /* it WILL modify word */
                                   bool try_uppercase,
-                                  IntrCheckInfo & ci, GuessInfo * gi)
+                                  IntrCheckInfo & ci, GuessInfo * gi) const
   {
     bool res = check_affix(word, ci, gi);
     if (res) return true;
@@ -182,7 +192,7 @@ namespace aspell { namespace sp {
                                     /* it WILL modify word */
                                     bool try_uppercase,
                                     unsigned run_together_limit,
-                                    IntrCheckInfo * ci, GuessInfo * gi)
+                                    IntrCheckInfo * ci, GuessInfo * gi) const
   {
     assert(run_together_limit <= 8); // otherwise it will go above the 
                                      // bounds of the word array
@@ -212,12 +222,93 @@ namespace aspell { namespace sp {
     return false;
   }
 
+  // The same as calling check on each word, except that the simple
+  // lookups for all the words are done together, one dictionary at a
+  // time, so that the dictionaries can pipeline them.  Only the words
+  // not found that way go through the affix and run-together checks.
+  PosibErr<void> SpellerImpl::check_words(MutableString * words, unsigned num,
+                                          unsigned char * res)
+  {
+    guess_info.reset();
+    check_inf[0].clear();
+    Vector<ParmString> to_find;
+    Vector<unsigned>   idx;
+    to_find.reserve(num);
+    idx.reserve(num);
+    for (unsigned i = 0; i != num; ++i) {
+      res[i] = words[i].size <= ignore_count;
+      if (res[i]) continue;
+      to_find.push_back(ParmString(words[i].str, words[i].size));
+      idx.push_back(i);
+    }
+    if (to_find.empty()) return no_err;
+    Vector<unsigned char> found(to_find.size());
+    for (WS::const_iterator i = check_ws.begin(); i != check_ws.end(); ++i)
+      (*i)->batch_lookup(to_find.pbegin(), to_find.size(), &s_cmp, found.pbegin());
+    unsigned run_together_limit 
+      = unconditional_run_together_ ? run_together_limit_ : 0;
+    for (unsigned j = 0; j != to_find.size(); ++j) {
+      unsigned i = idx[j];
+      if (found[j]) {res[i] = 1; continue;}
+      if (affix_compress) {
+        IntrCheckInfo ci;
+        ci.clear();
+        if (lang_->affix()->affix_check(LookupInfo(this, LookupInfo::Word), 
+                                        to_find[j], ci, 0))
+        {
+          res[i] = 1; 
+          continue;
+        }
+      }
+      if (run_together_limit > 1) {
+        PosibErr<bool> r = check(words[i].begin(), words[i].end(), false,
+                                 run_together_limit, check_inf, 0);
+        if (r.has_err()) return r;
+        res[i] = r.data;
+      }
+    }
+    check_inf[0].clear();
+    return no_err;
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  //
+  // Check contexts
+  //
+
+  class CheckContextImpl : public CheckContext
+  {
+    const SpellerImpl * sp_;
+    IntrCheckInfo check_inf_[8];
+    GuessInfo     guess_info_;
+  public:
+    CheckContextImpl(const SpellerImpl * sp) : sp_(sp) {}
+    PosibErr<bool> check(MutableString word) {
+      return sp_->check(word, check_inf_, guess_info_);
+    }
+    const IntrCheckInfo * intr_check_info() {
+      return SpellerImpl::intr_check_info(check_inf_, guess_info_);
+    }
+  };
+
+  PosibErr<void> SpellerImpl::freeze()
+  {
+    frozen_ = true;
+    return no_err;
+  }
+
+  CheckContext * SpellerImpl::new_check_context() const
+  {
+    return new CheckContextImpl(this);
+  }
+
   //////////////////////////////////////////////////////////////////////
   //
   // Word list managment methods
   //
   
   PosibErr<void> SpellerImpl::save_all_word_lists() {
+    if (frozen_) return frozen_error();
     SpellerDict * i = dicts_;
     for (; i; i = i->next) {
       if  (i->save_on_saveall)
@@ -226,6 +317,12 @@ namespace aspell { namespace sp {
     return no_err;
   }
   
+  PosibErr<void> SpellerImpl::warm() {
+    for (SpellerDict * i = dicts_; i; i = i->next)
+      i->dict->warm();
+    return no_err;
+  }
+  
   int SpellerImpl::num_wordlists() const {
     return 0; //FIXME
   }
@@ -437,6 +534,7 @@ namespace aspell { namespace sp {
       = i + sizeof(update_members)/sizeof(UpdateMember);
     while (i != end) {
       if (strcmp(ki->name, i->name) == 0) {
+        if (m->frozen()) return frozen_error();
         if (i->type == t) {
           RET_ON_ERR(i->fun.call(m, value));
           break;
@@ -453,7 +551,7 @@ namespace aspell { namespace sp {
   //
 
   SpellerImpl::SpellerImpl() 
-    : Speller(0) /* FIXME */, ignore_repl(true), 
+    : Speller(0) /* FIXME */, ignore_repl(true), frozen_(false),
       dicts_(0), personal_(0), session_(0), repl_(0), main_(0)
   {}
 
@@ -10,6 +10,8 @@
 #include "enumeration.hpp"
 #include "speller.hpp"
 #include "check_list.hpp"
+#include "stack_ptr.hpp"
+#include "thread.hpp"
 
 namespace aspell {
   class StringMap;
@@ -25,6 +27,7 @@ namespace aspell { namespace sp {
   class LangImpl;
   struct SensitiveCompare;
   class Suggest;
+  class SuggestHelpers;
 
   enum SpecialId {main_id, personal_id, session_id, 
                   personal_repl_id, none_id};
@@ -54,6 +57,11 @@ namespace aspell { namespace sp {
     PosibErr<void> reload_conv();
 
     Checker * new_checker();
+    Checker * new_checker(CheckContext *);
+
+    PosibErr<void> freeze();
+    bool frozen() const {return frozen_;}
+    CheckContext * new_check_context() const;
 
     //
     // Low level Word List Management methods
@@ -91,16 +99,25 @@ namespace aspell { namespace sp {
     // Spelling methods
     //
   
+    // The check methods that take the check info and guess info
+    // buffers as parameters don't change the speller so they may be
+    // used by several threads at once if the speller is frozen.
+
     PosibErr<bool> check(char * word, char * word_end, /* it WILL modify word */
                          bool try_uppercase,
 			 unsigned run_together_limit,
-			 IntrCheckInfo *, GuessInfo *);
+			 IntrCheckInfo *, GuessInfo *) const;
 
-    PosibErr<bool> check(MutableString word) {
-      guess_info.reset();
+    PosibErr<bool> check(MutableString word, 
+                         IntrCheckInfo * ci, GuessInfo & gi) const {
+      gi.reset();
       return check(word.begin(), word.end(), false,
 		   unconditional_run_together_ ? run_together_limit_ : 0,
-		   check_inf, &guess_info);
+		   ci, &gi);
+    }
+
+    PosibErr<bool> check(MutableString word) {
+      return check(word, check_inf, guess_info);
     }
     PosibErr<bool> check(ParmString word)
     {
@@ -113,20 +130,28 @@ namespace aspell { namespace sp {
 
     bool check2(char * word, /* it WILL modify word */
                 bool try_uppercase,
-                IntrCheckInfo & ci, GuessInfo * gi);
+                IntrCheckInfo & ci, GuessInfo * gi) const;
 
-    bool check_affix(ParmString word, IntrCheckInfo & ci, GuessInfo * gi);
+    bool check_affix(ParmString word, IntrCheckInfo & ci, GuessInfo * gi) const;
 
-    bool check_simple(ParmString, WordEntry &);
+    bool check_simple(ParmString, WordEntry &) const;
 
-    const IntrCheckInfo * intr_check_info() {
-      if (check_inf[0].word)
-        return check_inf;
-      else if (guess_info.head)
-        return guess_info.head;
+    PosibErr<void> check_words(MutableString * words, unsigned num,
+                               unsigned char * res);
+
+    static const IntrCheckInfo * intr_check_info(const IntrCheckInfo * ci,
+                                                 const GuessInfo & gi) {
+      if (ci[0].word)
+        return ci;
+      else if (gi.head)
+        return gi.head;
       else
         return 0;
     }
+
+    const IntrCheckInfo * intr_check_info() {
+      return intr_check_info(check_inf, guess_info);
+    }
     
     //
     // High level Word List management methods
@@ -139,6 +164,8 @@ namespace aspell { namespace sp {
 
     PosibErr<void> clear_session();
 
+    PosibErr<void> warm();
+
     PosibErr<const WordList *> suggest(MutableString word);
     // the suggestion list and the elements in it are only 
     // valid until the next call to suggest.
@@ -166,6 +193,7 @@ namespace aspell { namespace sp {
     ClonePtr<Suggest>       intr_suggest_;
     unsigned int            ignore_count;
     bool                    ignore_repl;
+    bool                    frozen_;
     String                  prev_mis_repl_;
     String                  prev_cor_repl_;
 
@@ -194,6 +222,9 @@ namespace aspell { namespace sp {
 
     IntrCheckInfo check_inf[8];
     GuessInfo guess_info;
+
+    ThreadPool thread_pool; // used by suggest to generate candidates
+    StackPtr<SuggestHelpers> suggest_helpers; // and the helpers it uses
     
     SensitiveCompare s_cmp;
     SensitiveCompare s_cmp_begin;  // These (s_cmp_begin,middle,end)
@@ -222,11 +253,11 @@ namespace aspell { namespace sp {
   };
 
   struct LookupInfo {
-    SpellerImpl * sp;
+    const SpellerImpl * sp;
     enum Mode {Word, Guess, Clean, Soundslike, AlwaysTrue} mode;
     SpellerImpl::WS::const_iterator begin;
     SpellerImpl::WS::const_iterator end;
-    inline LookupInfo(SpellerImpl * s, Mode m);
+    inline LookupInfo(const SpellerImpl * s, Mode m);
     // returns 0 if nothing found
     // 1 if a match is found
     // -1 if a word is found but affix doesn't match and "gi"
@@ -234,7 +265,7 @@ namespace aspell { namespace sp {
                 WordEntry & o, GuessInfo * gi) const;
   };
 
-  inline LookupInfo::LookupInfo(SpellerImpl * s, Mode m) 
+  inline LookupInfo::LookupInfo(const SpellerImpl * s, Mode m) 
     : sp(s), mode(m) 
   {
     switch (m) { 
@@ -92,6 +92,7 @@
 #include "speller_impl.hpp"
 #include "asuggest.hpp"
 #include "basic_list.hpp"
+#include "bp_editdist.hpp"
 #include "clone_ptr.hpp"
 #include "config.hpp"
 #include "data.hpp"
@@ -107,6 +108,7 @@
 #include "suggest.hpp"
 #include "vararray.hpp"
 #include "string_list.hpp"
+#include "thread.hpp"
 
 #include "gettext.h"
 
@@ -215,12 +217,14 @@ namespace {
     Score(const LangImpl *l, const String &w, const SuggestParms * p)
       : lang(l), original(), parms(p)
     {
+      set_word(w);
+    }
+    void set_word(const String & w) {
       original.word = w;
-      l->to_lower(original.lower, w.str());
-      l->to_clean(original.clean, w.str());
-      l->to_soundslike(original.soundslike, w.str());
-      original.case_pattern = l->case_pattern(w);
-      
+      lang->to_lower(original.lower, w.str());
+      lang->to_clean(original.clean, w.str());
+      lang->to_soundslike(original.soundslike, w.str());
+      original.case_pattern = lang->case_pattern(w);
     }
     void fix_case(char * str) {
       lang->LangImpl::fix_case(original.case_pattern, str, str);
@@ -238,6 +242,11 @@ namespace {
     EditDist (* edit_dist_fun)(const char *, const char *,
                                const EditDistanceWeights &);
 
+    // used to rule out words in score_list before calling the more
+    // expensive weighted edit distance functions
+    BitParallelEditDist clean_dist;
+    BitParallelEditDist soundslike_dist;
+
     unsigned int max_word_length;
 
     SpellerImpl  *     sp;
@@ -337,13 +346,20 @@ namespace {
       return false;
     }
 
+    bool check_split_word(ParmString word);
+
     void try_split();
     void try_one_edit_word();
     void try_scan();
     void try_scan_root();
+    void try_scan_level(int level);
     void try_repl();
     void try_ngram();
 
+    struct GeneratorTask;
+    struct Helpers;
+    int generate_parallel();
+
     void merge_dups();
  
     void score_list(bool score_all);
@@ -362,6 +378,23 @@ namespace {
 	    const String & w, const SuggestParms *  p)
       : Score(l,w,p), threshold(1), max_word_length(0), sp(m) {
       memset(check_info, 0, sizeof(check_info));
+      clean_dist.set(original.clean);
+      soundslike_dist.set(original.soundslike);
+    }
+    // readies a helper kept from an earlier call for a new word
+    void reset(const String & w, const SuggestParms * p) {
+      set_word(w);
+      parms = p;
+      threshold = 1;
+      max_word_length = 0;
+      scored_near_misses.clear();
+      near_misses.clear();
+      temp_end = 0;
+      buffer.reset();
+      temp_buffer.reset();
+      memset(check_info, 0, sizeof(check_info));
+      clean_dist.set(original.clean);
+      soundslike_dist.set(original.soundslike);
     }
     void get_suggestions(NearMissesFinal &sug);
   };
@@ -373,30 +406,42 @@ namespace {
 
     near_misses_final = & sug;
 
-    try_split();
+    int pre_scanned = 0; // the scan level already done by generate_parallel
 
-    if (parms->use_repl_table) {
+    if (parms->threads > 1) {
 
 #ifdef DEBUG_SUGGEST
-      COUT.printl("TRYING REPLACEMENT TABLE");
+      COUT.printl("TRYING GENERATORS IN PARALLEL");
 #endif
 
-      try_repl();
-    }
+      pre_scanned = generate_parallel();
 
-    if (parms->try_one_edit_word) {
+    } else {
+
+      try_split();
+
+      if (parms->use_repl_table) {
 
 #ifdef DEBUG_SUGGEST
-      COUT.printl("TRYING ONE EDIT WORD");
+        COUT.printl("TRYING REPLACEMENT TABLE");
 #endif
 
-      try_one_edit_word();
+        try_repl();
+      }
+
+      if (parms->try_one_edit_word) {
+
+#ifdef DEBUG_SUGGEST
+        COUT.printl("TRYING ONE EDIT WORD");
+#endif
 
-      if (parms->check_after_one_edit_word) {
-        score_list();
-        if (try_harder <= 0) goto done;
+        try_one_edit_word();
       }
+    }
 
+    if (parms->try_one_edit_word && parms->check_after_one_edit_word) {
+      score_list();
+      if (try_harder <= 0) goto done;
     }
 
     if (lang->affix() && lang->affix()->two_fold_suffix)
@@ -408,12 +453,9 @@ namespace {
 #ifdef DEBUG_SUGGEST
       COUT.printl("TRYING SCAN 1");
 #endif
-      edit_dist_fun = limit1_edit_distance;
 
-      if (sp->soundslike_root_only)
-        try_scan_root();
-      else
-        try_scan();
+      if (pre_scanned != 1)
+        try_scan_level(1);
 
       score_list();
       
@@ -427,12 +469,8 @@ namespace {
       COUT.printl("TRYING SCAN 2");
 #endif
 
-      edit_dist_fun = limit2_edit_distance;
-
-      if (sp->soundslike_root_only)
-        try_scan_root();
-      else
-        try_scan();
+      if (pre_scanned != 2)
+        try_scan_level(2);
 
       score_list();
       
@@ -459,6 +497,86 @@ namespace {
     transfer();
   }
 
+  //
+  // GeneratorTask runs one of the candidate generators on a helper
+  // Working object.  Each helper has its own buffers and near miss
+  // list, the only thing shared between threads is the speller, which
+  // is only read from.  The helpers are kept in the speller and
+  // reused by the next call, the near misses taken from them point
+  // into their buffers and so stay valid until then.
+  //
+
+  struct Working::Helpers : public SuggestHelpers {
+    Vector<Working *> list;
+    ~Helpers() {
+      for (Vector<Working *>::iterator i = list.begin(); i != list.end(); ++i)
+        delete *i;
+    }
+  };
+
+  struct Working::GeneratorTask : public Task {
+    enum What {Split, Repl, OneEditWord, Scan1, Scan2};
+    Working * working;
+    What      what;
+    void run() {
+      switch (what) {
+      case Split:       working->try_split();         break;
+      case Repl:        working->try_repl();          break;
+      case OneEditWord: working->try_one_edit_word(); break;
+      case Scan1:       working->try_scan_level(1);   break;
+      case Scan2:       working->try_scan_level(2);   break;
+      }
+    }
+  };
+
+  // Runs the candidate generators which do not depend on each other
+  // at the same time and then merges their near misses into this
+  // object in the same order they would have been added if they were
+  // run one after another.  The first scan only depends on the other
+  // generators when the list is scored after try_one_edit_word, if it
+  // is run here the scan level is returned, otherwise 0.
+  int Working::generate_parallel()
+  {
+    int scan_level = 0;
+    if (!(parms->try_one_edit_word && parms->check_after_one_edit_word)
+        && !(lang->affix() && lang->affix()->two_fold_suffix))
+      scan_level = parms->try_scan_1 ? 1 : parms->try_scan_2 ? 2 : 0;
+
+    GeneratorTask tasks[4];
+    Task * task_ptrs[4];
+    unsigned num = 0;
+    tasks[num++].what = GeneratorTask::Split;
+    if (parms->use_repl_table)
+      tasks[num++].what = GeneratorTask::Repl;
+    if (parms->try_one_edit_word)
+      tasks[num++].what = GeneratorTask::OneEditWord;
+    if (scan_level)
+      tasks[num++].what = scan_level == 1 ? GeneratorTask::Scan1 : GeneratorTask::Scan2;
+
+    if (!sp->suggest_helpers) sp->suggest_helpers.reset(new Helpers);
+    Vector<Working *> & helpers
+      = static_cast<Helpers *>(sp->suggest_helpers.get())->list;
+    for (unsigned i = 0; i != num; ++i) {
+      if (i == helpers.size())
+        helpers.push_back(new Working(sp, lang, original.word, parms));
+      else
+        helpers[i]->reset(original.word, parms);
+      tasks[i].working = helpers[i];
+      task_ptrs[i] = tasks + i;
+    }
+
+    sp->thread_pool.run(task_ptrs, task_ptrs + num, parms->threads);
+
+    for (unsigned i = 0; i != num; ++i) {
+      Working * h = tasks[i].working;
+      near_misses.splice_front(h->near_misses);
+      if (h->max_word_length > max_word_length)
+        max_word_length = h->max_word_length;
+    }
+
+    return scan_level;
+  }
+
   // Forms a word by combining IntrCheckInfo fields.
   // Will grow the grow the temp in the buffer.  The final
   // word must be null terminated and commited.
@@ -637,6 +755,19 @@ namespace {
                  w_score, sl_score, count);
   }
 
+  // Like SpellerImpl::check but does not store any information about
+  // the word in the speller, thus it is safe to use from more than one
+  // thread at once.
+  bool Working::check_split_word(ParmString word)
+  {
+    VARARRAY(char, w, word.size() + 1);
+    memcpy(w, word.str(), word.size() + 1);
+    IntrCheckInfo ci[8];
+    return sp->check(w, w + word.size(), false,
+                     sp->unconditional_run_together_ ? sp->run_together_limit_ : 0,
+                     ci, 0);
+  }
+
   void Working::try_split() {
     const String & word       = original.word;
     
@@ -655,7 +786,7 @@ namespace {
       new_word[i+1] = new_word[i];
       new_word[i] = '\0';
       
-      if (sp->check(new_word) && sp->check(new_word + i + 1)) {
+      if (check_split_word(new_word) && check_split_word(new_word + i + 1)) {
         for (size_t j = 0; j != parms->split_chars.size(); ++j)
         {
           new_word[i] = parms->split_chars[j];
@@ -865,6 +996,16 @@ namespace {
     }
   }
 
+  void Working::try_scan_level(int level)
+  {
+    edit_dist_fun = level == 1 ? limit1_edit_distance : limit2_edit_distance;
+
+    if (sp->soundslike_root_only)
+      try_scan_root();
+    else
+      try_scan();
+  }
+
   void Working::try_scan_root() 
   {
 
@@ -962,26 +1103,80 @@ namespace {
     }
   }
 
-  // generate an n-gram score comparing s1 and s2
-  static int ngram(int n, char * s1, int l1, const char * s2, int l2)
+  // Generates n-gram scores comparing a fixed word, s1, with other
+  // words, s2.  For n = 1, 2 and 3 the n-grams of s1 that appear
+  // anywhere in s2 are counted, stopping once fewer than two match,
+  // and a penalty is subtracted when s2 is much longer than s1.
+  //
+  // Rather than searching s2 for every n-gram of s1, the unigrams and
+  // bigrams of s2 are marked in tables, which are stamped with the
+  // number of the current word so they never need to be cleared, and
+  // the trigrams of s2 are collected in a short list.  Since the
+  // caller only wants scores of at least min_score, scoring also
+  // stops as soon as the best score still possible is too low.
+  class NGramScorer
   {
-    int nscore = 0;
-    int ns;
-    for (int j=1;j<=n;j++) {
-      ns = 0;
-      for (int i=0;i<=(l1-j);i++) {
-        char c = *(s1 + i + j);
-        *(s1 + i + j) = '\0';
-        if (strstr(s2,(s1+i))) ns++;
-        *(s1 + i + j ) = c;
+    const unsigned char *     s1_;
+    int              l1_;
+    Vector<unsigned> uni_;
+    Vector<unsigned> bi_;
+    Vector<unsigned> tri_;
+    unsigned         stamp_;
+
+    static unsigned bigram(const unsigned char * s) {return s[0] << 8 | s[1];}
+    static unsigned trigram(const unsigned char * s) {return s[0] << 16 | s[1] << 8 | s[2];}
+
+  public:
+    NGramScorer(const char * s1, int l1) 
+      : s1_(reinterpret_cast<const unsigned char *>(s1)), l1_(l1),
+        uni_(256, 0), bi_(256 * 256, 0), stamp_(0) {}
+
+    // returns the score, or 0 if the score is less than min_score
+    int score(const char * s2, int l2, int min_score)
+    {
+      const unsigned char * t = reinterpret_cast<const unsigned char *>(s2);
+      int penalty = l2 - l1_ - 2;
+      if (penalty < 0) penalty = 0;
+      int max_bi  = l1_ > 1 ? l1_ - 1 : 0;
+      int max_tri = l1_ > 2 ? l1_ - 2 : 0;
+      int best = l1_ + max_bi + max_tri - penalty;
+      if (best <= 0 || best < min_score) return 0;
+
+      if (++stamp_ == 0) {
+        // wrapped around, start over
+        memset(uni_.pbegin(), 0, uni_.size() * sizeof(unsigned));
+        memset(bi_.pbegin(), 0, bi_.size() * sizeof(unsigned));
+        stamp_ = 1;
       }
-      nscore = nscore + ns;
-      if (ns < 2) break;
+
+      for (int i = 0; i < l2; ++i)
+        uni_[t[i]] = stamp_;
+      int n1 = 0;
+      for (int i = 0; i < l1_; ++i)
+        n1 += uni_[s1_[i]] == stamp_;
+      if (n1 < 2) return n1 - penalty;
+      if (n1 + max_bi + max_tri - penalty < min_score) return 0;
+
+      for (int i = 0; i + 1 < l2; ++i)
+        bi_[bigram(t + i)] = stamp_;
+      int n2 = 0;
+      for (int i = 0; i + 1 < l1_; ++i)
+        n2 += bi_[bigram(s1_ + i)] == stamp_;
+      if (n2 < 2) return n1 + n2 - penalty;
+      if (n1 + n2 + max_tri - penalty < min_score) return 0;
+
+      tri_.clear();
+      for (int i = 0; i + 2 < l2; ++i)
+        tri_.push_back(trigram(t + i));
+      int n3 = 0;
+      for (int i = 0; i + 2 < l1_; ++i) {
+        unsigned g = trigram(s1_ + i);
+        for (Vector<unsigned>::const_iterator j = tri_.begin(); j != tri_.end(); ++j)
+          if (*j == g) {++n3; break;}
+      }
+      return n1 + n2 + n3 - penalty;
     }
-    ns = 0;
-    ns = (l2-l1)-2;
-    return (nscore - ((ns > 0) ? ns : 0));
-  }
+  };
 
   struct NGramScore {
     SpellerImpl::WS::const_iterator i;
@@ -997,8 +1192,7 @@ namespace {
 
   void Working::try_ngram()
   {
-    String original_soundslike = original.soundslike;
-    original_soundslike.ensure_null_end();
+    NGramScorer ngram(original.soundslike.str(), original.soundslike.size());
     WordEntry * sw = 0;
     const char * sl = 0;
     typedef Vector<NGramScore> Candidates;
@@ -1032,8 +1226,7 @@ namespace {
         
         if (already_have.have(sl)) continue;
 
-        int ng = ngram(3, original_soundslike.data(), original_soundslike.size(),
-                       sl, strlen(sl));
+        int ng = ngram.score(sl, strlen(sl), min_score);
 
         if (ng > 0 && ng >= min_score) {
           commit_temp(sl);
@@ -1171,6 +1364,7 @@ namespace {
             i->word_score = edit_distance(original.clean,
                                           i->word_clean,
                                           level, level,
+                                          clean_dist.count(i->word_clean),
                                           parms->edit_distance_weights);
         }
 
@@ -1182,6 +1376,13 @@ namespace {
 
           if (i->soundslike == 0) i->soundslike = to_soundslike(i->word, strlen(i->word));
 
+          // the score can only go up, so leave the soundslike score
+          // unknown if even the lower bound is too high
+          if (weighted_average(soundslike_dist.min_score(i->soundslike, 
+                                                         parms->edit_distance_weights),
+                               i->word_score) > try_for + parms->span)
+            goto cont1;
+
           i->soundslike_score = edit_distance(original.soundslike, i->soundslike, 
                                               parms->edit_distance_weights);
         }
@@ -1255,6 +1456,7 @@ namespace {
           i->word_score = edit_distance(original.clean.c_str(),
                                         i->word_clean,
                                         initial_level+1,max_level,
+                                        clean_dist.count(i->word_clean),
                                         parms->edit_distance_weights);
       }
 
@@ -1267,6 +1469,11 @@ namespace {
         if (i->soundslike == 0) 
           i->soundslike = to_soundslike(i->word, strlen(i->word));
         
+        if (weighted_average(soundslike_dist.min_score(i->soundslike, 
+                                                       parms->edit_distance_weights),
+                             i->word_score) > threshold + parms->span)
+          goto cont2;
+
         i->soundslike_score = edit_distance(original.soundslike, i->soundslike,
                                             parms->edit_distance_weights);
       }
@@ -1513,6 +1720,10 @@ namespace {
       parms_.split_chars.push_back(*s);
     }
 
+    parms_.threads = m->config()->retrieve_int("sug-threads");
+    if (parms_.threads <= 0)
+      parms_.threads = num_processors();
+
     String keyboard = m->config()->retrieve("keyboard");
     if (keyboard == "none")
       parms_.use_typo_analysis = false;
@@ -35,6 +35,14 @@ namespace aspell { namespace sp {
     virtual SuggestionList & suggest(const char * word) = 0;
     virtual ~Suggest() {}
   };
+
+  // What suggest keeps in the speller between calls, so that the
+  // helpers used to generate candidates in parallel are not created
+  // anew for every word.
+  class SuggestHelpers {
+  public:
+    virtual ~SuggestHelpers() {}
+  };
   
   PosibErr<Suggest *> new_default_suggest(SpellerImpl *);
 } }
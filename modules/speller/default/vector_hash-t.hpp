@@ -186,6 +186,96 @@ namespace aspell { namespace sp {
     for (iterator i = begin(); i != this->e; ++i, ++this->_size);
   }
 
+  template<class Parms>
+  GroupedHashTable<Parms>::GroupedHashTable(size_type i, const Parms & p)
+    : parms_(p), size_(0) 
+  {
+    // the hash functions used are not that good so use a prime
+    // number of groups
+    i = i / group_type::size + 1;
+    if (i < 3) i = 3;
+    Primes primes(static_cast<size_type>(sqrt(static_cast<double>(i))+2));
+    for (;;) {
+      if (i > primes.max_num())
+        primes.resize(static_cast<size_type>(sqrt(static_cast<double>(i))+2));
+      if (primes.is_prime(i))
+        break;
+      ++i;
+    }
+    vector_.resize(i);
+  }
+
+  template<class Parms>
+  typename GroupedHashTable<Parms>::const_iterator
+  GroupedHashTable<Parms>::find(const key_type & key, size_type h) const
+  {
+    unsigned char t = tag(h);
+    size_type g = h % vector_.size();
+    for (;;) {
+      const group_type & grp = vector_[g];
+      unsigned int m = match(grp, t);
+      for (unsigned int j = 0; m; ++j, m >>= 1) {
+        if ((m & 1) && parms_.equal(parms_.key(grp.value[j]), key))
+          return grp.value + j;
+      }
+      if (match(grp, 0)) return end();
+      if (++g == vector_.size()) g = 0;
+    }
+  }
+
+  template<class Parms>
+  typename GroupedHashTable<Parms>::const_iterator
+  GroupedHashTable<Parms>::first_candidate(size_type h) const
+  {
+    const group_type & grp = vector_[h % vector_.size()];
+    unsigned int m = match(grp, tag(h));
+    for (unsigned int j = 0; m; ++j, m >>= 1)
+      if (m & 1) return grp.value + j;
+    return end();
+  }
+
+  template<class Parms>
+  bool GroupedHashTable<Parms>::insert(const value_type & d)
+  {
+    key_type k = parms_.key(d);
+    size_type h = parms_.hash(k);
+    if (find(k, h) != end()) return false;
+    if (size_ + 1 > bucket_count() * 9 / 10)
+      resize(bucket_count() * 2);
+    unsigned char t = tag(h);
+    size_type g = h % vector_.size();
+    for (;;) {
+      group_type & grp = vector_[g];
+      for (unsigned int j = 0; j != group_type::size; ++j) {
+        if (grp.tag[j] == 0) {
+          grp.tag[j] = t;
+          grp.value[j] = d;
+          ++size_;
+          return true;
+        }
+      }
+      if (++g == vector_.size()) g = 0;
+    }
+  }
+
+  template<class Parms>
+  void GroupedHashTable<Parms>::swap(GroupedHashTable<Parms> &other) {
+    vector_.swap(other.vector_);
+    size_type temp = size_;
+    size_ = other.size_;
+    other.size_ = temp;
+  }
+
+  template<class Parms>
+  void GroupedHashTable<Parms>::resize(size_type i) {
+    GroupedHashTable temp(i,parms_);
+    for (size_type g = 0; g != vector_.size(); ++g)
+      for (unsigned int j = 0; j != group_type::size; ++j)
+        if (vector_[g].tag[j] != 0) 
+          temp.insert(vector_[g].value[j]);
+    swap(temp);
+  }
+
 } }
 
 #endif
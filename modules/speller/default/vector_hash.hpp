@@ -19,6 +19,10 @@
 #include "settings.h"
 #undef REL_OPS_POLLUTION  // FIXME
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 namespace aspell { namespace sp {
 
   //
@@ -286,6 +290,118 @@ namespace aspell { namespace sp {
     }
     
   };
+
+  ////////////////////////////////////////////////////////
+  //                                                    //
+  //               Grouped Hash Table                   //
+  //                                                    //
+  ////////////////////////////////////////////////////////
+
+  // This is also an Open Address Hash Table, but the buckets are
+  // grouped so that each group fills exactly one 64 byte cache line
+  // when the value is 4 bytes.  In front of the values is a one byte
+  // tag for each bucket, taken from the hash of the key, with 0
+  // meaning the bucket is empty.  When looking up a key only the
+  // buckets whose tag matches need to have their keys compared, so
+  // most failed lookups never touch the keys at all.  If the group is
+  // full the next group is tried.  Values can not be erased.
+
+  template <class Value>
+  struct HashGroup {
+    static const unsigned int size = 12;
+    unsigned char tag[16]; // the last 4 are unused
+    Value         value[size];
+  };
+
+  // Parms is expected to have the following
+  //   typename Vector
+  //   typedef HashGroup<Value> Vector::value_type
+  //   typename Value
+  //   typename Key
+  //   Size hash(Key)
+  //   bool equal(Key, Key)
+  //   Key key(Value)
+
+  template <class Parms>
+  class GroupedHashTable {
+  public:
+    typedef typename Parms::Vector           vector_type;
+    typedef typename vector_type::value_type group_type;
+    typedef typename vector_type::size_type  size_type;
+    typedef typename Parms::Value            value_type;
+    typedef typename Parms::Key              key_type;
+    typedef const value_type *               const_iterator;
+
+  private:
+    Parms       parms_;
+    vector_type vector_;
+    size_type   size_;
+
+  public:
+    typedef Parms parms_type;
+    const parms_type & parms() const {return parms_;}
+
+  public:
+    // These public functions are very dangerous and should be used with
+    // great care as the modify the internal structure of the object
+    vector_type & vector()       {return vector_;}
+    const vector_type & vector() const {return vector_;}
+    parms_type & parms() {return parms_;}
+    void set_size(size_type s) {size_  = s;} 
+
+  public:
+    GroupedHashTable(const Parms & p = Parms()) : parms_(p), size_(0) {}
+    // creates a table with room for at least i values
+    GroupedHashTable(size_type i, const Parms & p = Parms());
+
+    // returns false if the key was already in the table
+    bool insert(const value_type &);
+
+    // returns end() if the key is not found
+    const_iterator find(const key_type & k) const {return find(k, hash(k));}
+    const_iterator end() const {return 0;}
+
+    // These allow a batch of lookups to be pipelined.  First compute
+    // the hash value of every key and prefetch its group, then find
+    // each key using the hash value computed.  first_candidate returns
+    // the first value in the group whose tag matches, if any, so that
+    // its key can be prefetched as well.
+    size_type hash(const key_type & k) const {return parms_.hash(k);}
+    void prefetch(size_type h) const {
+#ifdef __GNUC__
+      __builtin_prefetch(&vector_[h % vector_.size()]);
+#endif
+    }
+    const_iterator find(const key_type &, size_type h) const;
+    const_iterator first_candidate(size_type h) const;
+
+    size_type size() const {return size_;}
+    bool      empty() const {return !size_;}
+
+    void swap(GroupedHashTable &);
+    void resize(size_type);
+    size_type bucket_count() const {return vector_.size() * group_type::size;}
+    double load_factor() const {return static_cast<double>(size())/bucket_count();}
+
+  private:
+    static unsigned char tag(size_type h) {
+      unsigned int t = static_cast<unsigned int>(h) * 2654435761u >> 24;
+      return t ? t : 1;
+    }
+    // returns a bit mask of the buckets in g with the tag t
+    static unsigned int match(const group_type & g, unsigned char t) {
+#ifdef __SSE2__
+      __m128i tags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g.tag));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8(t)))
+        & ((1 << group_type::size) - 1);
+#else
+      unsigned int m = 0;
+      for (unsigned int j = 0; j != group_type::size; ++j)
+        if (g.tag[j] == t) m |= 1 << j;
+      return m;
+#endif
+    }
+  };
 } }
 
 #endif
@@ -6,6 +6,12 @@
 
 #include <time.h>
 
+#include "settings.h"
+
+#if !defined(WIN32) && !defined(_WIN32)
+#  include <unistd.h>
+#endif
+
 #include "file_util.hpp"
 #include "hash-t.hpp"
 #include "data.hpp"
@@ -15,6 +21,7 @@
 #include "fstream.hpp"
 #include "lang_impl.hpp"
 #include "getdata.hpp"
+#include "vector_hash-t.hpp"
 
 namespace {
 
@@ -133,27 +140,60 @@ bool getline_n_unescape(FStream & in, DataPair & d, String & buf)
   return true;
 }
 
+//
+// Since every entry of a personal dictionary is on a line of its own
+// the file also serves as a journal: when it is saved the entries
+// added since it was last written are appended to the end of it
+// rather than writing out the whole dictionary again, and when it
+// was changed by another process in the same way only the lines
+// after the part that was already read are merged.  Once the
+// appended entries grow to be half as many as the whole dictionary,
+// or when appending is not possible, the file is written out in full
+// again.
+//
+
 class WritableBase : public Dictionary {
 protected:
   String suffix;
   String compatibility_suffix;
     
   time_t cur_file_date;
+  long   cur_file_size;
+  String cur_file_tail; // the last few bytes of the file
   
   String compatibility_file_name;
+
+  bool can_append; // the file is in the format save writes and holds
+                   // all entries but the pending ones
+  bool merging;    // entries being added come from the file
+  unsigned appended; // entries appended since the file was written
     
   WritableBase(BasicType t, const char * n, const char * s, const char * cs)
     : Dictionary(t,n),
       suffix(s), compatibility_suffix(cs),
+      cur_file_date(0), cur_file_size(0),
+      can_append(false), merging(false), appended(0),
       personal_no_hint(false), personal_sort(false),
       use_soundslike(true) {fast_lookup = true;}
   virtual ~WritableBase() {}
   
   virtual PosibErr<void> save(FStream &, ParmString) = 0;
   virtual PosibErr<void> merge(FStream &, ParmString, Config * = 0) = 0;
+  // merges the entries after the header from the current position
+  virtual PosibErr<void> merge_tail(FStream &, ParmString) = 0;
+
+  // the entries added since the file was last written
+  virtual unsigned pending_size() const = 0;
+  virtual void save_pending(FStream &) = 0;
+  virtual void clear_pending() = 0;
+
+  PosibErr<void> merge_saved(FStream &, ParmString, Config * = 0, 
+                             bool tail = false);
+  bool only_appended(FStream &, long & file_size);
     
   PosibErr<void> save2(FStream &, ParmString);
-  PosibErr<void> update(FStream &, ParmString);
+  PosibErr<void> update(FStream &, ParmString, bool tail = false);
+  PosibErr<void> append(FStream &);
   PosibErr<void> save(bool do_update);
   PosibErr<void> update_file_date_info(FStream &);
   PosibErr<void> load(ParmString, Config &, DictList *, SpellerImpl *);
@@ -179,11 +219,47 @@ protected:
  
 };
 
+static const long file_tail_size = 32;
+
 PosibErr<void> WritableBase::update_file_date_info(FStream & f) {
   RET_ON_ERR(update_file_info(f));
   cur_file_date = get_modification_time(f);
+  f.seek(0, SEEK_END);
+  cur_file_size = f.tell();
+  long n = cur_file_size < file_tail_size ? cur_file_size : file_tail_size;
+  cur_file_tail.resize(n);
+  f.seek(cur_file_size - n);
+  if (n != 0) f.read(cur_file_tail.data(), n);
   return no_err;
 }
+
+//
+// Return true if the file is the one last read or written, with
+// possibly some lines appended to it, and leave it positioned at the
+// end of the part already read.  "file_size" is set to its current
+// size.
+//
+bool WritableBase::only_appended(FStream & f, long & file_size) {
+  if (cur_file_tail.empty() || cur_file_tail.back() != '\n') return false;
+  f.seek(0, SEEK_END);
+  file_size = f.tell();
+  if (file_size < cur_file_size) return false;
+  long n = cur_file_tail.size();
+  String tail;
+  tail.resize(n);
+  f.seek(cur_file_size - n);
+  if (!f.read(tail.data(), n) || tail != cur_file_tail) return false;
+  return true;
+}
+
+PosibErr<void> WritableBase::merge_saved(FStream & in, ParmString fn,
+                                         Config * config, bool tail)
+{
+  merging = true;
+  PosibErr<void> pe = tail ? merge_tail(in, fn) : merge(in, fn, config);
+  merging = false;
+  return pe;
+}
   
 PosibErr<void> WritableBase::load(ParmString f0, Config & config,
                                   DictList *, SpellerImpl *)
@@ -200,7 +276,7 @@ PosibErr<void> WritableBase::load(ParmString f0, Config & config,
     RET_ON_ERR(open_file_readlock(in, f));
     if (in.peek() == EOF) return make_err(cant_read_file,f); 
     // ^^ FIXME 
-    RET_ON_ERR(merge(in, f, &config));
+    RET_ON_ERR(merge_saved(in, f, &config));
       
   } else if (f.substr(f.size()-suffix.size(),suffix.size()) 
              == suffix) {
@@ -212,7 +288,7 @@ PosibErr<void> WritableBase::load(ParmString f0, Config & config,
       PosibErr<void> pe = open_file_readlock(in, compatibility_file_name);
       if (pe.has_err()) {compatibility_file_name = ""; return pe;}
     } {
-      PosibErr<void> pe = merge(in, compatibility_file_name, &config);
+      PosibErr<void> pe = merge_saved(in, compatibility_file_name, &config);
       if (pe.has_err()) {compatibility_file_name = ""; return pe;}
     }
       
@@ -230,13 +306,16 @@ PosibErr<void> WritableBase::merge(ParmString f0) {
   Dict::FileName fn(f0);
   RET_ON_ERR(open_file_readlock(in, fn.path));
   RET_ON_ERR(merge(in, fn.path));
+  // the entries merged are not in our file and the encoding may
+  // have changed
+  can_append = false;
   return no_err;
 }
 
-PosibErr<void> WritableBase::update(FStream & in, ParmString fn) {
+PosibErr<void> WritableBase::update(FStream & in, ParmString fn, bool tail) {
   typedef PosibErr<void> Ret;
   {
-    Ret pe = merge(in, fn);
+    Ret pe = merge_saved(in, fn, 0, tail);
     if (pe.has_err() && compatibility_file_name.empty()) return pe;
   } {
     Ret pe = update_file_date_info(in);
@@ -252,6 +331,23 @@ PosibErr<void> WritableBase::save2(FStream & out, ParmString fn) {
 
   out.flush();
 
+  clear_pending();
+  can_append = true;
+  appended = 0;
+
+  return no_err;
+}
+
+PosibErr<void> WritableBase::append(FStream & out) {
+  if (pending_size() == 0) return no_err;
+  out.seek(0, SEEK_END);
+  save_pending(out);
+  out.flush();
+#if !defined(WIN32) && !defined(_WIN32)
+  fsync(out.file_no());
+#endif
+  appended += pending_size();
+  clear_pending();
   return no_err;
 }
 
@@ -270,12 +366,24 @@ PosibErr<void> WritableBase::save(bool do_update) {
   RET_ON_ERR_SET(open_file_writelock(inout, file_name()),
                  bool, prev_existed);
 
-  if (do_update
-      && prev_existed 
-      && get_modification_time(inout) > cur_file_date)
+  long file_size = 0;
+  bool intact = prev_existed && can_append
+    && compatibility_file_name.empty() && only_appended(inout, file_size);
+
+  if (do_update && intact) {
+    if (file_size != cur_file_size)
+      RET_ON_ERR(update(inout, file_name(), true));
+  } else if (do_update
+             && prev_existed 
+             && get_modification_time(inout) > cur_file_date) {
     RET_ON_ERR(update(inout, file_name()));
+  }
 
-  RET_ON_ERR(save2(inout, file_name()));
+  if (intact && !personal_sort
+      && (appended + pending_size()) * 2 <= size())
+    RET_ON_ERR(append(inout));
+  else
+    RET_ON_ERR(save2(inout, file_name()));
   RET_ON_ERR(update_file_date_info(inout));
     
   if (compatibility_file_name.size() != 0) {
@@ -386,28 +494,6 @@ struct ElementsParms {
   static Value end_state() {return 0;}
 };
 
-static void soundslike_next(WordEntry * w)
-{
-  const WordRec *const * &i  = (const WordRec *const *&)(w->intr[0]);
-  const WordRec *const * end = (const WordRec *const *) (w->intr[1]);
-  set_word(*w, (*i)->word_rec());
-  ++i;
-  if (i == end) w->adv_ = 0;
-}
-
-static void sl_init( WordRec *const * i,
-						   WordRec *const * end, WordEntry & o)
-{
-  set_word(o, (*i)->word_rec());
-  ++i;
-  if (i != end) {
-    o.intr[0] = (void *)i;
-    o.intr[1] = (void *)end;
-    o.adv_ = soundslike_next;
-  } else {
-    o.intr[0] = 0;
-  }
-}
 static void soundslike_next_repl(WordEntry * w)
 {
   const WordReplRec *const * &i  = (const WordReplRec *const *&)(w->intr[0]);
@@ -431,21 +517,130 @@ static void sl_init( WordReplRec *const * i,
   }
 }
 /////////////////////////////////////////////////////////////////////
-// 
+//
 //  WritableDict
 //
 
+//
+// The words are allocated one after another in "buffer", where they
+// never move, and both the word table and the soundslike table are
+// open address hash tables which only hold pointers to them.  The
+// words with the same soundslike are linked together in the order
+// they were added, so no memory is needed for them beyond one
+// pointer for each word.
+//
+
+//
+// Store a word of a WritableDict.
+//  The rec is variable length and must be last
+//
+struct DictWordRec
+{
+  DictWordRec * next; // the next word with the same soundslike
+  WordRec rec;
+  const char * key() const { return rec.word_; }
+  const WordRec * word_rec() const { return &rec; }
+};
+
+//
+// Store a soundslike and the words that have it.
+//  The sl is variable length and must be last
+//
+struct SoundslikeRec
+{
+  DictWordRec * first;
+  DictWordRec * last;
+  char sl[1];
+};
+
+struct WordTableParms
+{
+  typedef aspell::Vector<DictWordRec *> Vector;
+  typedef DictWordRec *                 Value;
+  typedef const char *                  Key;
+  enum { is_multi = 1 };
+  WordTableParms(const Hash & h, const Equal & e) : hash(h), equal(e) {}
+  Hash  hash;
+  Equal equal;
+  Key key(Value v) const { return v->key(); }
+  bool is_nonexistent(Value v) const { return v == 0; }
+  void make_nonexistent(Value & v) const { v = 0; }
+};
+
+struct SoundslikeTableParms
+{
+  typedef aspell::Vector<SoundslikeRec *> Vector;
+  typedef SoundslikeRec *                 Value;
+  typedef const char *                    Key;
+  enum { is_multi = 0 };
+  aspell::hash<const char *> hash;
+  bool equal(Key a, Key b) const { return strcmp(a, b) == 0; }
+  Key key(Value v) const { return v->sl; }
+  bool is_nonexistent(Value v) const { return v == 0; }
+  void make_nonexistent(Value & v) const { v = 0; }
+};
+
+// An enumeration of the soundslike records.
+// It passes each soundslike to the caller as a WordEntry object.
+struct SoundslikeRecElements : public SoundslikeEnumeration {
+
+  typedef VectorHashTable<SoundslikeTableParms>::const_iterator Itr;
+
+  Itr i;
+  Itr end;
+
+  WordEntry d;
+
+  SoundslikeRecElements(Itr i0, Itr end0) : i(i0), end(end0) {
+    d.what = WordEntry::Soundslike;
+  }
+
+  WordEntry * next(int) {
+    if (i == end) return 0;
+    set_sl(d, (*i)->sl);
+    d.intr[0] = (void *)*i;
+    ++i;
+    return &d;
+  }
+};
+
+static void soundslike_next(WordEntry * w)
+{
+  const DictWordRec * & i = (const DictWordRec * &)(w->intr[0]);
+  set_word(*w, i->word_rec());
+  i = i->next;
+  if (!i) w->adv_ = 0;
+}
+
+static void sl_init(const DictWordRec * i, WordEntry & o)
+{
+  set_word(o, i->word_rec());
+  i = i->next;
+  if (i) {
+    o.intr[0] = (void *)i;
+    o.adv_ = soundslike_next;
+  } else {
+    o.intr[0] = 0;
+  }
+}
+
 class WritableDict : public WritableBase
 {
 public:
-  // The key is the soundslike string, the value is the vector of words
-  typedef WordVec LookupVec;
-  typedef hash_map<Str,LookupVec> SoundslikeLookup;
-  typedef HashTable<LookupParams<WordRec *> > WordLookup;
+  typedef VectorHashTable<WordTableParms>       WordLookup;
+  typedef VectorHashTable<SoundslikeTableParms> SoundslikeLookup;
 
 public: // but don't use
   PosibErr<void> save(FStream &, ParmString);
   PosibErr<void> merge(FStream &, ParmString, Config * config);
+  PosibErr<void> merge_tail(FStream &, ParmString);
+  PosibErr<void> merge_words(FStream &, ParmString, unsigned ver);
+
+  unsigned pending_size() const {return pending.size();}
+  void save_pending(FStream & out) {
+    save_words(out, pending.begin(), pending.end());
+  }
+  void clear_pending() {pending.clear();}
 
 public:
 
@@ -454,7 +649,7 @@ public:
   Size   size()     const;
   bool   empty()    const;
   PosibErr<void> clear();
-  
+
   PosibErr<void> add(ParmString w) {return Dictionary::add(w);}
   PosibErr<void> add(ParmString w, ParmString s);
 
@@ -470,30 +665,33 @@ public:
   SoundslikeEnumeration * soundslike_elements() const;
   void set_lang_hook(Config & c) {
     set_file_encoding(lang()->data_encoding(), c);
-    word_lookup.reset(new WordLookup(10,LookupParams<WordRec *>(
-		 Hash(lang()), Equal(lang()))));
+    word_lookup.reset(new WordLookup(WordTableParms(Hash(lang()),
+                                                    Equal(lang()))));
     use_soundslike = lang()->have_soundslike();
   }
 protected:
-  StackPtr<WordLookup> word_lookup;
-  SoundslikeLookup     soundslike_lookup_;
+  StackPtr<WordLookup>   word_lookup;
+  SoundslikeLookup       soundslike_lookup_;
+  Vector<DictWordRec *>  pending;
 
 };
 
-WritableDict::Size WritableDict::size() const 
+WritableDict::Size WritableDict::size() const
 {
   return word_lookup->size();
 }
 
-bool WritableDict::empty() const 
+bool WritableDict::empty() const
 {
   return word_lookup->empty();
 }
 
-PosibErr<void> WritableDict::clear() 
+PosibErr<void> WritableDict::clear()
 {
-  word_lookup->clear();
-  soundslike_lookup_.clear();
+  word_lookup.reset(new WordLookup(word_lookup->parms()));
+  SoundslikeLookup().swap(soundslike_lookup_);
+  pending.clear();
+  can_append = false;
   buffer.reset();
   return no_err;
 }
@@ -502,15 +700,15 @@ bool WritableDict::lookup(ParmString word, const SensitiveCompare * c,
                           WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(word));
-  while (p.first != p.second) {
-    WordRec * w= *p.first;
+  const WordLookup & words = *word_lookup;
+  WordLookup::ConstFindIterator i = words.multi_find(word);
+  for (; !i.at_end(); i.adv()) {
+    const DictWordRec * w = i.deref();
     if ((*c)(word,w->key())) {
       o.what = WordEntry::Word;
-      set_word(o, w);
+      set_word(o, w->word_rec());
       return true;
     }
-    ++p.first;
   }
   return false;
 }
@@ -518,39 +716,39 @@ bool WritableDict::lookup(ParmString word, const SensitiveCompare * c,
 bool WritableDict::clean_lookup(const char * sl, WordEntry & o) const
 {
   o.clear();
-  pair<WordLookup::iterator, WordLookup::iterator> p(word_lookup->equal_range(sl));
-  if (p.first == p.second) return false; // empty
+  const WordLookup & words = *word_lookup;
+  WordLookup::ConstFindIterator i = words.multi_find(sl);
+  if (i.at_end()) return false; // empty
   o.what = WordEntry::Word;
-  WordRec *rec = *p.first;
-  set_word(o, rec);
+  set_word(o, i.deref()->word_rec());
   return true;
   // FIXME: Deal with multiple entries
-}  
+}
 
-bool WritableDict::soundslike_lookup(const WordEntry & word, WordEntry & o) const 
+bool WritableDict::soundslike_lookup(const WordEntry & word, WordEntry & o) const
 {
   if (use_soundslike) {
 
-    const LookupVec * tmp 
-      = (const LookupVec *)(word.intr[0]);
+    const SoundslikeRec * tmp
+      = (const SoundslikeRec *)(word.intr[0]);
     o.clear();
 
     o.what = WordEntry::Word;
-    sl_init(tmp->pbegin(),tmp->pend(), o);
+    sl_init(tmp->first, o);
 
   } else {
-      
+
     o.what = WordEntry::Word;
     o.word = word.word;
     o.word_size = word.word_size;
     o.word_info = word.word_info;
     o.aff  = "";
-    
+
   }
   return true;
 }
 
-bool WritableDict::soundslike_lookup(ParmString word, WordEntry & o) const 
+bool WritableDict::soundslike_lookup(ParmString word, WordEntry & o) const
 {
   if (use_soundslike) {
 
@@ -560,11 +758,10 @@ bool WritableDict::soundslike_lookup(ParmString word, WordEntry & o) const
       return false;
     } else {
       o.what = WordEntry::Word;
-      LookupVec *v = &(i->second);
-      sl_init(v->pbegin(), v->pend(), o);
+      sl_init((*i)->first, o);
       return true;
     }
-  
+
   } else {
 
     return WritableDict::clean_lookup(word, o);
@@ -574,24 +771,25 @@ bool WritableDict::soundslike_lookup(ParmString word, WordEntry & o) const
 
 SoundslikeEnumeration * WritableDict::soundslike_elements() const
 {
+  const WordLookup & words = *word_lookup;
   if (use_soundslike)
-    return new SoundslikeElements<SoundslikeLookup>(soundslike_lookup_.begin(), 
-                                                    soundslike_lookup_.end());
+    return new SoundslikeRecElements(soundslike_lookup_.begin(),
+                                     soundslike_lookup_.end());
   else
-    return new CleanElements<WordLookup>(word_lookup->begin(),
-                                         word_lookup->end());
+    return new CleanElements<WordLookup>(words.begin(), words.end());
 }
 
 WritableDict::Enum * WritableDict::detailed_elements() const
 {
   typedef ElementsParms<WordLookup> WordElements;
+  const WordLookup & words = *word_lookup;
   return new MakeEnumeration<WordElements>
-    (word_lookup->begin(),WordElements(word_lookup->end()));
+    (words.begin(),WordElements(words.end()));
 }
 
 //
 // Add a word and soundlike to the dictionary.
-// we allocate a buffers with these implied structure:
+// The soundslike is only stored once, for the first word that has it.
 //
 PosibErr<void> WritableDict::add(ParmString w, ParmString s)
 {
@@ -599,16 +797,27 @@ PosibErr<void> WritableDict::add(ParmString w, ParmString s)
   SensitiveCompare c(lang());
   WordEntry we;
   if (WritableDict::lookup(w,&c,we)) return no_err;
-  WordRec *rec = static_cast<WordRec *>(buffer.alloc(sizeof(WordRec) + w.size()));
-  rec->word_info_ = lang()->get_word_info(w);
-  rec->size_ = w.size();
-  memcpy(rec->word_, w.str(), w.size() + 1);
+  DictWordRec * rec = static_cast<DictWordRec *>
+    (buffer.alloc(sizeof(DictWordRec) + w.size(), sizeof(void *)));
+  rec->next = 0;
+  rec->rec.word_info_ = lang()->get_word_info(w);
+  rec->rec.size_ = w.size();
+  memcpy(rec->rec.word_, w.str(), w.size() + 1);
   word_lookup->insert(rec);
   if (use_soundslike) {
-    char *soundslike = static_cast<char *>(buffer.alloc(s.size() +1));
-    memcpy(soundslike,s.str(), s.size() + 1);
-    soundslike_lookup_[soundslike].push_back(rec);
+    SoundslikeLookup::iterator i = soundslike_lookup_.find(s);
+    if (i == soundslike_lookup_.end()) {
+      SoundslikeRec * sl = static_cast<SoundslikeRec *>
+        (buffer.alloc(sizeof(SoundslikeRec) + s.size(), sizeof(void *)));
+      sl->first = sl->last = rec;
+      memcpy(sl->sl, s.str(), s.size() + 1);
+      soundslike_lookup_.insert(sl);
+    } else {
+      (*i)->last->next = rec;
+      (*i)->last = rec;
+    }
   }
+  if (!merging) pending.push_back(rec);
   return no_err;
 }
 
@@ -640,14 +849,33 @@ PosibErr<void> WritableDict::merge(FStream & in,
       return pe.with_file(file_name);
   }
 
-  split(dp); // count not used at the moment
+  split(dp); // only a hint, the number of words when last written
+  unsigned count = atoi(dp.key);
 
   split(dp);
   if (dp.key.size > 0)
     set_file_encoding(dp.key, *config);
   else
     set_file_encoding("", *config);
-  
+
+  RET_ON_ERR(merge_words(in, file_name, ver));
+  can_append = ver == 11;
+  appended = size() > count ? size() - count : 0;
+  return no_err;
+}
+
+PosibErr<void> WritableDict::merge_tail(FStream & in, ParmString file_name)
+{
+  return merge_words(in, file_name, 11);
+}
+
+PosibErr<void> WritableDict::merge_words(FStream & in, 
+                                         ParmString file_name,
+                                         unsigned ver)
+{
+  typedef PosibErr<void> Ret;
+  String buf;
+  DataPair dp;
   ConvP conv(iconv);
   while (getline_n_unescape(in, dp, buf)) {
     if (ver == 10)
@@ -674,7 +902,7 @@ inline void WritableBase::save_words(FStream& out, InputIterator i, InputIterato
 }
 
 // return true if r1 < r2
-inline bool compare_word_rec(WordRec const* r1, WordRec const* r2)
+inline bool compare_word_rec(DictWordRec const* r1, DictWordRec const* r2)
 {
   return strcmp(r1->key(), r2->key()) < 0;
 }
@@ -687,10 +915,11 @@ PosibErr<void> WritableDict::save(FStream & out, ParmString file_name)
              lang_name(), size, file_encoding.c_str());
 
   if (personal_sort) {
-    // WordVec sorted_words(word_lookup->begin(), word_lookup->end());
-    // WordVec doesn't support the iterator copy constructor
-    WordVec sorted_words;
-    sorted_words.assign(word_lookup->begin(), word_lookup->end());
+    Vector<DictWordRec *> sorted_words;
+    sorted_words.reserve(word_lookup->size());
+    WordLookup::iterator e = word_lookup->end();
+    for (WordLookup::iterator i = word_lookup->begin(); i != e; ++i)
+      sorted_words.push_back(*i);
     // NOTE: std::sort is likely an overkill here
     std::sort(sorted_words.begin(), sorted_words.end(), compare_word_rec);
     save_words(out, sorted_words.begin(), sorted_words.end());
@@ -754,8 +983,20 @@ public:
 private:
   PosibErr<void> save(FStream &, ParmString );
   PosibErr<void> merge(FStream &, ParmString , Config * config);
+  PosibErr<void> merge_tail(FStream &, ParmString);
+  unsigned merge_repls(FStream &);
+
+  // a misspelled word and one of its replacements
+  typedef std::pair<const WordReplRec *, const WordRec *> Repl;
+  void save_repl(FStream &, Repl);
+
+  unsigned pending_size() const {return pending.size();}
+  void save_pending(FStream & out);
+  void clear_pending() {pending.clear();}
+
   StackPtr<WordLookup>   word_lookup;
   SoundslikeLookup soundslike_lookup_;
+  Vector<Repl>     pending;
 };
 
 WritableReplDict::Size WritableReplDict::size() const 
@@ -772,6 +1013,8 @@ PosibErr<void> WritableReplDict::clear()
 {
   word_lookup->clear();
   soundslike_lookup_.clear();
+  pending.clear();
+  can_append = false;
   buffer.reset();
   return no_err;
 }
@@ -958,6 +1201,7 @@ PosibErr<void> WritableReplDict::add_repl(ParmString mis, ParmString cor, ParmSt
   rec->size_ = cor.size();
   memcpy(rec->word_, cor.str(), cor.size() + 1);
   v.push_back(rec);
+  if (!merging) pending.push_back(Repl(repl, rec));
 
   if (use_soundslike) {
     // Allocate space for the soundslike string, save the Word/Replace record
@@ -971,29 +1215,41 @@ PosibErr<void> WritableReplDict::add_repl(ParmString mis, ParmString cor, ParmSt
 
 PosibErr<void> WritableReplDict::save (FStream & out, ParmString file_name) 
 {
-  out.printf("personal_repl-1.1 %s 0 %s\n", lang_name(), file_encoding.c_str());
-  
   WordLookup::iterator i = word_lookup->begin();
   WordLookup::iterator e = word_lookup->end();
 
-  ConvP conv1(oconv);
-  ConvP conv2(oconv);
-  
+  unsigned count = 0;
+  for (WordLookup::iterator j = i; j != e; ++j)
+    count += (*j)->correct.size();
+
+  out.printf("personal_repl-1.1 %s %u %s\n", 
+             lang_name(), count, file_encoding.c_str());
+
   for (;i != e; ++i) 
   {
     WordReplRec *repl = (*i);
     WordVec & v = repl->correct;
     for (WordVec::iterator j = v.begin(); j != v.end(); ++j)
-    {
-      write_n_escape(out, conv1(repl->key()));
-      out << ' ';
-      write_n_escape(out, conv2((*j)->key()));
-      out << '\n';
-    }
+      save_repl(out, Repl(repl, *j));
   }
   return no_err;
 }
 
+void WritableReplDict::save_pending(FStream & out)
+{
+  for (Vector<Repl>::iterator i = pending.begin(); i != pending.end(); ++i)
+    save_repl(out, *i);
+}
+
+void WritableReplDict::save_repl(FStream & out, Repl r)
+{
+  ConvP conv(oconv);
+  write_n_escape(out, conv(r.first->key()));
+  out << ' ';
+  write_n_escape(out, conv(r.second->key()));
+  out << '\n';
+}
+
 PosibErr<void> WritableReplDict::merge(FStream & in,
                                        ParmString file_name, 
                                        Config * config)
@@ -1029,7 +1285,8 @@ PosibErr<void> WritableReplDict::merge(FStream & in,
     num_soundslikes = atoi(dp.key);
   }
 
-  split(dp); // not used at the moment
+  split(dp); // only a hint, the number of replacements when last written
+  unsigned count = atoi(dp.key);
 
   split(dp);
   if (dp.key.size > 0)
@@ -1039,19 +1296,9 @@ PosibErr<void> WritableReplDict::merge(FStream & in,
 
   if (version == 11) {
 
-    ConvP conv1(iconv);
-    ConvP conv2(iconv);
-    for (;;) {
-      bool res = getline_n_unescape(in, buf, '\n');
-      if (!res) break;
-      char * mis = buf.mstr();
-      char * repl = strchr(mis, ' ');
-      if (!repl) continue; // bad line, ignore
-      *repl = '\0'; // split string
-      ++repl;
-      if (!repl[0]) continue; // empty repl, ignore
-      WritableReplDict::add_repl(conv1(mis), conv2(repl));
-    }
+    unsigned read = merge_repls(in);
+    can_append = true;
+    appended = read > count ? read - count : 0;
     
   } else {
     
@@ -1073,6 +1320,33 @@ PosibErr<void> WritableReplDict::merge(FStream & in,
   return no_err;
 }
 
+PosibErr<void> WritableReplDict::merge_tail(FStream & in, ParmString)
+{
+  merge_repls(in);
+  return no_err;
+}
+
+unsigned WritableReplDict::merge_repls(FStream & in)
+{
+  unsigned read = 0;
+  String buf;
+  ConvP conv1(iconv);
+  ConvP conv2(iconv);
+  for (;;) {
+    bool res = getline_n_unescape(in, buf, '\n');
+    if (!res) break;
+    char * mis = buf.mstr();
+    char * repl = strchr(mis, ' ');
+    if (!repl) continue; // bad line, ignore
+    *repl = '\0'; // split string
+    ++repl;
+    if (!repl[0]) continue; // empty repl, ignore
+    WritableReplDict::add_repl(conv1(mis), conv2(repl));
+    ++read;
+  }
+  return read;
+}
+
 WritableReplDict::~WritableReplDict()
 {
   WordLookup::iterator i = word_lookup->begin();
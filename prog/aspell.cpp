@@ -34,6 +34,11 @@
 # include <fcntl.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+# include <errno.h>
+#endif
+
 #include "file_util.hpp"
 #include "fstream.hpp"
 #include "asc_ctype.hpp"
@@ -45,11 +50,13 @@
 #include "errors.hpp"
 #include "info.hpp"
 #include "iostream.hpp"
+#include "lock.hpp"
 #include "posib_err.hpp"
 #include "speller.hpp"
 #include "stack_ptr.hpp"
 #include "string_enumeration.hpp"
 #include "string_map.hpp"
+#include "thread.hpp"
 #include "word_list.hpp"
 
 #include "string_list.hpp"
@@ -75,6 +82,7 @@ void convt();
 void normlz();
 void filter();
 void list();
+void scan();
 void dicts();
 void modes();
 void filters();
@@ -170,6 +178,7 @@ const PossibleOption possible_options[] = {
   COMMAND("check",     'c',  0),
   COMMAND("pipe",      'a',  0),
   COMMAND("list",      '\0', 0),
+  COMMAND("scan",      '\0', 0),
   COMMAND("conv",      '\0', 2),
   COMMAND("norm",      '\0', 1),
   COMMAND("filter",    '\0', 0),
@@ -246,6 +255,65 @@ static void line_buffer() {
 #endif
 }
 
+static const size_t stream_block_size = 64*1024;
+
+static void block_buffer() {
+  // set up stdout to be fully buffered, stdin is read directly by
+  // BlockLineReader
+  setvbuf(stdout, 0, _IOFBF, stream_block_size);
+}
+
+// Reads stdin a block at a time and hands it out a line at a time.
+// Standard output is only flushed right before a read that may
+// block, so that the results for everything read so far are sent
+// without flushing after every line.
+class BlockLineReader {
+  char * buf;
+  size_t begin, end;
+  bool eof;
+  BlockLineReader(const BlockLineReader &);
+  void operator=(const BlockLineReader &);
+  void fill() {
+    fflush(stdout);
+    if (!buf) buf = new char[stream_block_size];
+#ifdef HAVE_UNISTD_H
+    ssize_t n;
+    do {
+      n = read(0, buf, stream_block_size);
+    } while (n < 0 && errno == EINTR);
+#else
+    size_t n = fread(buf, 1, stream_block_size, stdin);
+#endif
+    begin = 0;
+    if (n > 0) end = n;
+    else {end = 0; eof = true;}
+  }
+public:
+  BlockLineReader() 
+    : buf(0), begin(0), end(0), eof(false) {}
+  ~BlockLineReader() {delete[] buf;}
+  // appends the next line to "line", without the new line, returns
+  // false if the end of input was reached first
+  bool getline(CharVector & line) {
+    for (;;) {
+      if (begin == end) {
+        if (eof) return false;
+        fill();
+        continue;
+      }
+      char * b = buf + begin;
+      char * nl = static_cast<char *>(memchr(b, '\n', end - begin));
+      if (nl) {
+        line.append(b, nl - b);
+        begin += nl - b + 1;
+        return true;
+      }
+      line.append(b, end - begin);
+      begin = end;
+    }
+  }
+};
+
 Conv dconv;
 Conv uiconv;
 
@@ -415,6 +483,8 @@ int main (int argc, const char *argv[])
     pipe();
   else if (action_str == "list")
     list();
+  else if (action_str == "scan")
+    scan();
   else if (action_str == "conv")
     convt();
   else if (action_str == "norm")
@@ -699,7 +769,11 @@ void print_elements(const AspellWordList * wl) {
 
 void pipe() 
 {
-  line_buffer();
+  bool stream = options->retrieve_bool("stream");
+  if (stream)
+    block_buffer();
+  else
+    line_buffer();
 
   bool terse_mode = false;
   bool do_time = options->retrieve_bool("time");
@@ -735,14 +809,21 @@ void pipe()
   char * word2;
   int    ignore;
   PosibErrBase err;
+  BlockLineReader in;
+  unsigned line_num = 0;
 
   print_ver();
 
   for (;;) {
     buf.clear();
-    fflush(stdout);
-    while (c = getchar(), c != '\n' && c != EOF)
-      buf.push_back(static_cast<char>(c));
+    if (stream) {
+      c = in.getline(buf) ? '\n' : EOF;
+    } else {
+      fflush(stdout);
+      while (c = getchar(), c != '\n' && c != EOF)
+        buf.push_back(static_cast<char>(c));
+    }
+    if (c != EOF || !buf.empty()) ++line_num;
     buf.push_back('\n'); // always add new line so strlen > 0
     buf.push_back('\0');
     line = buf.data();
@@ -909,7 +990,10 @@ void pipe()
                         (finish-start)/(double)CLOCKS_PER_SEC);
         }
       }
-      COUT.put('\n');
+      if (stream)
+        COUT.printf("=%u\n", line_num);
+      else
+        COUT.put('\n');
     }
     if (c == EOF) break;
     continue;
@@ -1276,6 +1360,189 @@ void list()
   delete_aspell_speller(speller);
 }
 
+///////////////////////////
+//
+// scan
+//
+
+// The input is split into blocks of whole lines which are checked by
+// a pool of workers, each with its own checker for the same frozen
+// speller.  A batch of blocks is checked at a time and the results
+// printed in input order once the whole batch is done, so the output
+// does not depend on the number of threads.
+//
+// Every block is first checked starting from the state the filters
+// are in at the start of a document.  Once the batch is done the
+// state each block ended in is compared, in order, with the state
+// the next block of the same file was started from, and if they
+// differ that block is checked again starting from the right state.
+// Most blocks end outside of any construct the filters keep track of
+// so this is rare.  If a filter can not save its state, each block
+// is checked as if it was a new document.
+
+static const size_t scan_block_size = 64*1024;
+
+struct ScanBlock {
+  const char * name; // file name, "-" for standard input
+  unsigned first_line;
+  bool first;        // first block of the file
+  String text;
+  String result;
+  String start_state; // filter state the block was checked from
+  String end_state;   // and the one it ended in
+};
+
+class ScanQueue {
+  Mutex lock;
+  ScanBlock * cur;
+  ScanBlock * end;
+public:
+  ScanQueue(ScanBlock * b, ScanBlock * e) : cur(b), end(e) {}
+  ScanBlock * next() {
+    LOCK(&lock);
+    if (cur == end) return 0;
+    return cur++;
+  }
+};
+
+class ScanWorker : public Task {
+public:
+  StackPtr<Checker> checker;
+  MBLen mb_len;
+  bool stateful; // if the filter state can be saved and restored
+  ScanQueue * queue;
+  void run() {
+    ScanBlock * b;
+    while ((b = queue->next()) != 0)
+      scan(*b);
+  }
+  void scan(ScanBlock &);
+};
+
+void ScanWorker::scan(ScanBlock & b)
+{
+  checker->reset();
+  if (stateful) checker->restore_filter_state(b.start_state.str());
+  b.result.clear();
+  const char * line = b.text.str();
+  const char * end = line + b.text.size();
+  unsigned line_num = b.first_line;
+  for (; line != end; ++line_num) {
+    const char * eol = static_cast<const char *>(memchr(line, '\n', end - line));
+    eol = eol ? eol + 1 : end;
+    // the newline is included as filters may end a construct at it
+    checker->process(line, eol - line);
+    const CheckerToken * token;
+    while ((token = checker->next_misspelling()) != 0) {
+      b.result.printf("%s:%u:%u: ", b.name, line_num, 
+                      mb_len(line, token->begin.offset) + 1);
+      b.result.append(line + token->begin.offset, 
+                      token->end.offset - token->begin.offset);
+      b.result.append('\n');
+    }
+    line = eol;
+  }
+  b.end_state.clear();
+  if (stateful) checker->save_filter_state(b.end_state);
+}
+
+// "state" is the state the last block of the previous batch ended in
+static void scan_batch(Vector<ScanBlock> & blocks, 
+                       Vector<ScanWorker *> & workers,
+                       String & state)
+{
+  ScanQueue queue(blocks.pbegin(), blocks.pend());
+  Vector<Task *> tasks;
+  for (unsigned i = 0; i != workers.size(); ++i) {
+    workers[i]->queue = &queue;
+    tasks.push_back(workers[i]);
+  }
+  run_parallel(tasks.pbegin(), tasks.pend(), tasks.size());
+  for (Vector<ScanBlock>::iterator i = blocks.begin(); i != blocks.end(); ++i) {
+    if (workers[0]->stateful && !i->first && i->start_state != state) {
+      i->start_state = state;
+      workers[0]->scan(*i);
+    }
+    state = i->end_state;
+    COUT.write(i->result.str(), i->result.size());
+  }
+  blocks.clear();
+}
+
+void scan()
+{
+  AspellSpeller * speller = new_speller();
+  Speller * real_speller = reinterpret_cast<Speller *>(speller);
+  Config * config = real_speller->config();
+  EXIT_ON_ERR(real_speller->freeze());
+
+  unsigned num_threads = options->retrieve_int("threads");
+  if (num_threads == 0) num_threads = num_processors();
+
+  Vector<ScanWorker *> workers;
+  String initial_state;
+  for (unsigned i = 0; i != num_threads; ++i) {
+    EXIT_ON_ERR_SET(new_thread_checker(real_speller), Checker *, checker);
+    ScanWorker * w = new ScanWorker;
+    w->checker.reset(checker);
+    initial_state.clear();
+    checker->reset();
+    w->stateful = checker->save_filter_state(initial_state);
+    if (!config->retrieve_bool("byte-offsets")) 
+      EXIT_ON_ERR(w->mb_len.setup(*config, config->retrieve("encoding")));
+    workers.push_back(w);
+  }
+
+  const unsigned batch_size = num_threads * 16;
+  Vector<ScanBlock> blocks;
+  blocks.reserve(batch_size);
+  String state;
+
+  Vector<String> files(args);
+  if (files.empty()) files.push_back("-");
+  int ret = 0;
+  for (Vector<String>::iterator i = files.begin(); i != files.end(); ++i) {
+    FILE * in = *i == "-" ? stdin : fopen(i->str(), "r");
+    if (!in) {
+      print_error(_("Could not open the file \"%s\" for reading"), *i);
+      ret = 1;
+      continue;
+    }
+    unsigned line_num = 1;
+    for (;;) {
+      blocks.push_back(ScanBlock());
+      ScanBlock & b = blocks.back();
+      b.name = i->str();
+      b.first_line = line_num;
+      b.first = line_num == 1;
+      b.start_state = initial_state;
+      b.text.resize(scan_block_size);
+      size_t size = fread(b.text.mstr(), 1, scan_block_size, in);
+      b.text.resize(size);
+      // extend the block to the end of the line
+      int c;
+      if (size == scan_block_size && b.text.back() != '\n')
+        while (c = getc(in), c != EOF) {
+          b.text.append(static_cast<char>(c));
+          if (c == '\n') break;
+        }
+      for (const char * p = b.text.str(), * e = p + b.text.size(); 
+           (p = static_cast<const char *>(memchr(p, '\n', e - p))) != 0; ++p)
+        ++line_num;
+      if (b.text.empty()) blocks.pop_back();
+      if (blocks.size() == batch_size) scan_batch(blocks, workers, state);
+      if (size < scan_block_size) break;
+    }
+    if (in != stdin) fclose(in);
+  }
+  scan_batch(blocks, workers, state);
+
+  for (unsigned i = 0; i != workers.size(); ++i)
+    delete workers[i];
+  delete_aspell_speller(speller);
+  if (ret) exit(ret);
+}
+
 ///////////////////////////
 //
 // convt
@@ -1911,6 +2178,7 @@ static const char * help_text[] =
   usage_text[4],
   usage_text[5],
   N_("  list             produce a list of misspelled words from standard input"),
+  N_("  scan [<file>...] list misspelled words in files using several threads"),
   usage_text[6],
   usage_text[7],
   N_("  soundslike       returns the sounds like equivalent for each word entered"),